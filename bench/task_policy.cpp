@@ -0,0 +1,111 @@
+// Frame size and await cost of tiny leaf tasks per task policy.
+// Build in release mode: xmake f -m release && xmake build bench_task_policy && xmake run bench_task_policy
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <print>
+#include <vector>
+
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "task_policy.hpp"
+
+namespace {
+
+    std::size_t last_frame_bytes = 0;
+
+    // Records the bytes of the last frame allocated through it, whatever it is rebound to
+    template<typename T>
+    struct recording_allocator
+    {
+        using value_type = T;
+
+        recording_allocator() noexcept = default;
+        template<typename U>
+        recording_allocator(const recording_allocator<U>&) noexcept {}
+
+        T* allocate(std::size_t n) {
+            last_frame_bytes = n * sizeof(T);
+            return std::allocator<T>{}.allocate(n);
+        }
+
+        void deallocate(T* p, std::size_t n) noexcept { std::allocator<T>{}.deallocate(p, n); }
+
+        friend bool operator==(const recording_allocator&, const recording_allocator&) noexcept { return true; }
+    };
+
+    template<typename Policy>
+    mylib::task<std::uint64_t, Policy> leaf(std::uint64_t x) {
+        co_return x * 3 + 1;
+    }
+
+    template<typename Policy>
+    mylib::task<std::uint64_t, Policy> measured_leaf(std::allocator_arg_t, const recording_allocator<std::byte>&, std::uint64_t x) {
+        co_return x * 3 + 1;
+    }
+
+    // Frame created, awaited and freed one at a time, so it is recycled hot
+    template<typename Policy>
+    mylib::task<std::uint64_t> await_one_by_one(std::size_t n) {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += co_await leaf<Policy>(i);
+        }
+        co_return sum;
+    }
+
+    // All frames alive at once before any runs, so the footprint decides how much of them stays in cache
+    template<typename Policy>
+    mylib::task<std::uint64_t> await_batch(std::vector<mylib::task<std::uint64_t, Policy>>& batch) {
+        std::uint64_t sum = 0;
+        for (auto& t : batch) {
+            sum += co_await std::move(t);
+        }
+        co_return sum;
+    }
+
+    double ns_per(std::chrono::steady_clock::duration d, std::size_t n) {
+        return std::chrono::duration<double, std::nano>(d).count() / static_cast<double>(n);
+    }
+
+    template<typename Policy>
+    void run(const char* name) {
+        using clock = std::chrono::steady_clock;
+        constexpr std::size_t sequential = std::size_t{ 1 } << 24;
+        constexpr std::size_t batched = std::size_t{ 1 } << 21;
+
+        { auto _ = measured_leaf<Policy>(std::allocator_arg, {}, 0); }
+        const std::size_t frame_bytes = last_frame_bytes;
+
+        const clock::time_point t0 = clock::now();
+        const std::uint64_t s0 = mylib::sync_wait(await_one_by_one<Policy>(sequential));
+        const clock::time_point t1 = clock::now();
+
+        std::vector<mylib::task<std::uint64_t, Policy>> batch;
+        batch.reserve(batched);
+        for (std::size_t i = 0; i < batched; ++i) {
+            batch.push_back(leaf<Policy>(i));
+        }
+        const clock::time_point t2 = clock::now();
+        const std::uint64_t s1 = mylib::sync_wait(await_batch<Policy>(batch));
+        const clock::time_point t3 = clock::now();
+
+        std::println("{:<20} {:>7} {:>6} {:>12.2f} {:>12.2f} {:>12.2f}   (checksum {})",
+            name, sizeof(typename mylib::task<std::uint64_t, Policy>::promise_type), frame_bytes,
+            ns_per(t1 - t0, sequential), ns_per(t2 - t1, batched), ns_per(t3 - t2, batched), s0 ^ s1);
+    }
+
+} // namespace
+
+int main() {
+    std::println("{:<20} {:>7} {:>6} {:>12} {:>12} {:>12}",
+        "policy", "promise", "frame", "ns/await", "ns/create", "ns/await");
+    std::println("{:<20} {:>7} {:>6} {:>12} {:>12} {:>12}",
+        "", "bytes", "bytes", "one by one", "batched", "batched");
+    run<mylib::default_task_policy>("default_task_policy");
+    run<mylib::nothrow_policy>("nothrow_policy");
+    run<mylib::no_cancel_policy>("no_cancel_policy");
+    run<mylib::leaf_policy>("leaf_policy");
+}
@@ -0,0 +1,237 @@
+#ifndef MYLIB_ASYNC_SCOPE_H
+#define MYLIB_ASYNC_SCOPE_H 1
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "detached_task.hpp"
+#include "executor.hpp"
+#include "frame_allocator.hpp"
+
+namespace mylib {
+
+    class async_scope;
+
+    namespace details {
+
+        class [[nodiscard]] scope_task
+        {
+        public:
+            struct promise_type : mylib::details::pooled_frame
+            {
+                template<typename... Args>
+                promise_type(async_scope& scope, Args&...) noexcept : scope(&scope) {}
+
+                scope_task get_return_object() noexcept {
+                    return scope_task(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() noexcept { return {}; }
+
+                struct final_awaiter
+                {
+                    constexpr bool await_ready() const noexcept { return false; }
+
+                    // Leaving the scope may resume the joiner, the frame is gone by then
+                    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+
+                    constexpr void await_resume() const noexcept { std::unreachable(); }
+                };
+
+                final_awaiter final_suspend() noexcept { return {}; }
+
+                void return_void() noexcept {}
+
+                // Kept in the frame, which the scope holds on to until join
+                void unhandled_exception() noexcept { this->exception = std::current_exception(); }
+
+                inline std::coroutine_handle<> unhandled_stopped() noexcept;
+
+                inline static std::coroutine_handle<> leave_scope(void* scope) noexcept;
+
+                async_scope* scope;
+                std::exception_ptr exception;
+                // Intrusive link in the failed list of the scope, so failing never allocates
+                promise_type* next_failed = nullptr;
+            };
+
+            scope_task(const scope_task&) = delete;
+            scope_task& operator=(const scope_task&) = delete;
+
+            scope_task(scope_task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+            ~scope_task() { if (this->handle) { this->handle.destroy(); } }
+
+            std::coroutine_handle<> get() const noexcept { return this->handle; }
+
+            std::coroutine_handle<> to_handle() && noexcept { return std::exchange(this->handle, nullptr); }
+
+        private:
+            explicit scope_task(std::coroutine_handle<promise_type> handle) noexcept : handle(handle) {}
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        template<typename Awaitable>
+        scope_task scope_driver(async_scope&, Awaitable a) {
+            co_await std::move(a);
+        }
+
+    } // namespace mylib::details
+
+    // Owner of detached work.
+    // Every spawned awaitable runs in a small driver frame counted by one atomic, which also holds
+    // a reference of the scope itself until join. co_await scope.join() resumes once everything
+    // spawned has completed, giving the exceptions of the failed ones in completion order; a stopped
+    // task just completes. A failed frame is kept on an intrusive list until join frees it.
+    // The scope must be joined before it is destroyed, and can be reused after join.
+    class async_scope
+    {
+    public:
+        async_scope() = default;
+
+        async_scope(const async_scope&) = delete;
+        async_scope& operator=(const async_scope&) = delete;
+
+        ~async_scope() {
+            assert(this->live.load(std::memory_order_relaxed) == 1 && "Scope destroyed with live tasks.");
+            // Left over only if a join could not allocate its result
+            promise_type* f = this->failed.load(std::memory_order_relaxed);
+            while (f) {
+                std::coroutine_handle<promise_type>::from_promise(*std::exchange(f, f->next_failed)).destroy();
+            }
+        }
+
+        // Start awaitable on the calling thread, it runs until its first suspension
+        template<typename Awaitable>
+        void spawn(Awaitable&& a) {
+            this->make_driver(std::forward<Awaitable>(a)).to_handle().resume();
+        }
+
+        // Start awaitable on ex. If ex cannot take it, it is freed and not counted, and the error rethrown.
+        template<mylib::executor Executor, typename Awaitable>
+        void spawn(Executor& ex, Awaitable&& a) {
+            details::scope_task t = this->make_driver(std::forward<Awaitable>(a));
+            try {
+                ex.enqueue(t.get());
+            } catch (...) {
+                // Last out if a join is pending meanwhile
+                this->leave().resume();
+                throw;
+            }
+            static_cast<void>(std::move(t).to_handle());
+        }
+
+        // Number of spawned tasks not completed yet
+        std::size_t size() const noexcept {
+            return this->live.load(std::memory_order_relaxed) - 1;
+        }
+
+        struct [[nodiscard]] join_awaiter
+        {
+            bool await_ready() const noexcept {
+                return this->scope->live.load(std::memory_order_acquire) == 1;
+            }
+
+            bool await_suspend(std::coroutine_handle<> h) noexcept {
+                this->scope->joiner = h;
+                // Drop the reference of the scope, resume right away if every task is done
+                return this->scope->live.fetch_sub(1, std::memory_order_acq_rel) != 1;
+            }
+
+            // Throws only if the result cannot be allocated, the failures then stay for the next join
+            std::vector<std::exception_ptr> await_resume() {
+                this->scope->live.store(1, std::memory_order_relaxed);
+                return this->scope->take_failures();
+            }
+
+            async_scope* scope;
+        };
+
+        join_awaiter join() noexcept { return { this }; }
+
+    private:
+        using promise_type = details::scope_task::promise_type;
+
+        friend promise_type;
+        friend promise_type::final_awaiter;
+
+        // Counted once allocated, still owned by the returned task until started
+        template<typename Awaitable>
+        details::scope_task make_driver(Awaitable&& a) {
+            details::scope_task t = details::scope_driver(*this, std::forward<Awaitable>(a));
+            this->live.fetch_add(1, std::memory_order_relaxed);
+            return t;
+        }
+
+        // Published to the joiner by the release in leave
+        void fail(promise_type& p) noexcept {
+            promise_type* head = this->failed.load(std::memory_order_relaxed);
+            do {
+                p.next_failed = head;
+            } while (!this->failed.compare_exchange_weak(head, &p, std::memory_order_relaxed));
+        }
+
+        // Every task is done, nothing pushes meanwhile
+        std::vector<std::exception_ptr> take_failures() {
+            std::size_t n = 0;
+            for (promise_type* f = this->failed.load(std::memory_order_relaxed); f; f = f->next_failed) {
+                ++n;
+            }
+            std::vector<std::exception_ptr> failures(n);
+            promise_type* f = this->failed.exchange(nullptr, std::memory_order_relaxed);
+            // The list is newest first
+            while (f) {
+                promise_type& p = *std::exchange(f, f->next_failed);
+                failures[--n] = std::move(p.exception);
+                std::coroutine_handle<promise_type>::from_promise(p).destroy();
+            }
+            return failures;
+        }
+
+        std::coroutine_handle<> leave() noexcept {
+            if (this->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                return this->joiner;
+            }
+            return std::noop_coroutine();
+        }
+
+        std::atomic<std::size_t> live = 1;
+        std::coroutine_handle<> joiner = nullptr;
+        std::atomic<promise_type*> failed = nullptr;
+    };
+
+    namespace details {
+
+        inline std::coroutine_handle<> scope_task::promise_type::final_awaiter::await_suspend(
+            std::coroutine_handle<promise_type> h) noexcept
+        {
+            async_scope* scope = h.promise().scope;
+            if (h.promise().exception) {
+                scope->fail(h.promise());
+            } else {
+                h.destroy();
+            }
+            return scope->leave();
+        }
+
+        inline std::coroutine_handle<> scope_task::promise_type::leave_scope(void* scope) noexcept {
+            return static_cast<async_scope*>(scope)->leave();
+        }
+
+        inline std::coroutine_handle<> scope_task::promise_type::unhandled_stopped() noexcept {
+            // The stop chain is still running inside this frame, the reaper destroys it from outside
+            return mylib::details::frame_reaper::reap(std::coroutine_handle<promise_type>::from_promise(*this),
+                &leave_scope, this->scope);
+        }
+
+    } // namespace mylib::details
+
+} // namespace mylib
+
+#endif // MYLIB_ASYNC_SCOPE_H
@@ -0,0 +1,129 @@
+#ifndef MYLIB_AWAITABLE_TRAITS_H
+#define MYLIB_AWAITABLE_TRAITS_H 1
+
+#include <concepts>
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+namespace mylib {
+
+    namespace details {
+
+        template<typename Awaitable>
+        concept member_co_await = requires (Awaitable&& a) { std::forward<Awaitable>(a).operator co_await(); };
+
+        template<typename Awaitable>
+        concept adl_co_await = requires (Awaitable&& a) { operator co_await(std::forward<Awaitable>(a)); };
+
+        template<typename Awaitable>
+        struct awaiter_traits {
+            using type = Awaitable;
+        };
+
+        template<member_co_await Awaitable>
+        struct awaiter_traits<Awaitable> {
+            using type = decltype(std::declval<Awaitable>().operator co_await());
+        };
+
+        template<adl_co_await Awaitable>
+        struct awaiter_traits<Awaitable> {
+            using type = decltype(operator co_await(std::declval<Awaitable>()));
+        };
+
+        template<typename Awaitable>
+        using awaiter_type = awaiter_traits<Awaitable>::type;
+
+        template<typename Awaitable>
+        concept nothrow_co_await = [] {
+            if constexpr (member_co_await<Awaitable>) {
+                return requires (Awaitable&& a) { { std::forward<Awaitable>(a).operator co_await() } noexcept; };
+            } else if constexpr (adl_co_await<Awaitable>) {
+                return requires (Awaitable&& a) { { operator co_await(std::forward<Awaitable>(a)) } noexcept; };
+            } else {
+                return true;
+            }
+        }();
+
+        template<typename Awaitable>
+        awaiter_type<Awaitable> get_awaiter(Awaitable&& a) noexcept(nothrow_co_await<Awaitable>) {
+            if constexpr (requires { std::forward<Awaitable>(a).operator co_await(); }) {
+                return std::forward<Awaitable>(a).operator co_await();
+            } else if constexpr (requires { operator co_await(std::forward<Awaitable>(a)); }) {
+                return operator co_await(std::forward<Awaitable>(a));
+            } else {
+                return std::forward<Awaitable>(a);
+            }
+        }
+
+        template<typename Awaitable>
+        using await_result_t = decltype(std::declval<awaiter_type<Awaitable>>().await_resume());
+
+        // Call a.await_suspend(h) and give the coroutine to resume next, whatever it returns
+        template<typename Awaiter, typename Promise>
+        std::coroutine_handle<> await_suspend_to(Awaiter& a, std::coroutine_handle<Promise> h) {
+            using result_type = decltype(a.await_suspend(h));
+            if constexpr (std::is_void_v<result_type>) {
+                a.await_suspend(h);
+                return std::noop_coroutine();
+            } else if constexpr (std::same_as<result_type, bool>) {
+                return a.await_suspend(h) ? std::noop_coroutine() : std::coroutine_handle<>(h);
+            } else {
+                return a.await_suspend(h);
+            }
+        }
+
+        // An awaitable together with its awaiter, kept in place for the whole await.
+        // For awaiting by hand from inside a promise, without a wrapper coroutine.
+        template<typename Awaitable>
+        class awaiting
+        {
+        public:
+            template<std::invocable MakeAwaitable>
+            explicit awaiting(MakeAwaitable&& make)
+                : awaitable(std::forward<MakeAwaitable>(make)()), awaiter(make_awaiter(this->awaitable))
+            {}
+
+            awaiting(const awaiting&) = delete;
+            awaiting& operator=(const awaiting&) = delete;
+
+            bool await_ready() { return this->get().await_ready(); }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) {
+                return details::await_suspend_to(this->get(), h);
+            }
+
+            decltype(auto) await_resume() { return this->get().await_resume(); }
+
+        private:
+            constexpr static bool self_awaiter = std::same_as<awaiter_type<Awaitable>, Awaitable>;
+
+            struct no_awaiter {};
+            using awaiter_storage = std::conditional_t<self_awaiter, no_awaiter, awaiter_type<Awaitable>>;
+
+            static awaiter_storage make_awaiter(Awaitable& a) {
+                if constexpr (self_awaiter) {
+                    return {};
+                } else {
+                    return details::get_awaiter(std::move(a));
+                }
+            }
+
+            auto& get() noexcept {
+                if constexpr (self_awaiter) {
+                    return this->awaitable;
+                } else {
+                    return this->awaiter;
+                }
+            }
+
+            Awaitable awaitable;
+            [[no_unique_address]] awaiter_storage awaiter;
+        };
+
+    } // namespace mylib::details
+
+} // namespace mylib
+
+#endif // MYLIB_AWAITABLE_TRAITS_H
@@ -173,6 +173,7 @@ namespace mylib {
     {
     public:
         using return_type = ReturnType;
+        using policy_type = mylib::default_task_policy;
         using promise_type = details::callcc_promise<callcc_task>;
         using handle_type = typename promise_type::handle_type;
         using callcc_task_awaiter = mylib::details::task_awaiter<callcc_task>;
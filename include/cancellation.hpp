@@ -5,10 +5,15 @@
 #include <concepts>
 #include <coroutine>
 #include <exception>
+#include <type_traits>
 #include <utility>
 
+#include "frame_allocator.hpp"
+#include "stop_token.hpp"
+
 namespace mylib {
 
+    // The handle a stopped handler returns is to be resumed right away, on the thread which called it
     using stopped_handler_type = std::coroutine_handle<>(*)(void*) noexcept;
 
     [[noreturn]]
@@ -30,9 +35,25 @@ namespace mylib {
             .promise().unhandled_stopped();
     }
 
+    template<typename PromiseType>
+    concept has_stop_token = requires(const PromiseType& p) {
+        { p.get_stop_token() } noexcept -> std::same_as<mylib::inplace_stop_token>;
+    };
+
+    // Stop token of the coroutine owning promise p, a token of nothing if it carries none
+    template<typename PromiseType>
+    mylib::inplace_stop_token get_stop_token_of(const PromiseType& p) noexcept {
+        if constexpr (mylib::has_stop_token<PromiseType>) {
+            return p.get_stop_token();
+        } else {
+            return {};
+        }
+    }
+
     class cancellation_base
     {
     public:
+        // Also inherits the stop token of the caller
         template<typename OtherPromise>
         std::coroutine_handle<> set_continuation(std::coroutine_handle<OtherPromise> c) noexcept {
             if constexpr (mylib::has_unhandled_stopped<OtherPromise>) {
@@ -40,9 +61,20 @@ namespace mylib {
             } else {
                 this->stopped_handler = &mylib::null_stopped_handler;
             }
+            if constexpr (!std::is_void_v<OtherPromise>) {
+                this->stop_token = mylib::get_stop_token_of(c.promise());
+            }
             return std::exchange(this->continuation, c);
         }
 
+        mylib::inplace_stop_token get_stop_token() const noexcept {
+            return this->stop_token;
+        }
+
+        void set_stop_token(mylib::inplace_stop_token token) noexcept {
+            this->stop_token = token;
+        }
+
         std::coroutine_handle<> get_continuation() const noexcept {
             return this->continuation;
         }
@@ -54,12 +86,74 @@ namespace mylib {
     private:
         std::coroutine_handle<> continuation = std::noop_coroutine();
         stopped_handler_type stopped_handler = &mylib::null_stopped_handler;
+        mylib::inplace_stop_token stop_token;
     };
 
+    // Continuation only, for coroutines that never complete stopped.
+    // Carries no stopped handler and no stop token.
+    class continuation_base
+    {
+    public:
+        template<typename OtherPromise>
+        std::coroutine_handle<> set_continuation(std::coroutine_handle<OtherPromise> c) noexcept {
+            return std::exchange(this->continuation, c);
+        }
+
+        std::coroutine_handle<> get_continuation() const noexcept {
+            return this->continuation;
+        }
+
+    private:
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+    };
+
+    namespace details {
+
+        struct [[nodiscard]] get_stop_token_awaiter
+        {
+            constexpr bool await_ready() const noexcept { return false; }
+
+            template<typename PromiseType>
+            bool await_suspend(std::coroutine_handle<PromiseType> h) noexcept {
+                this->token = mylib::get_stop_token_of(h.promise());
+                return false;
+            }
+
+            mylib::inplace_stop_token await_resume() const noexcept { return this->token; }
+
+            mylib::inplace_stop_token token;
+        };
+
+        struct [[nodiscard]] stop_checkpoint_awaiter
+        {
+            constexpr bool await_ready() const noexcept { return false; }
+
+            template<typename PromiseType>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> h) noexcept {
+                if constexpr (mylib::has_unhandled_stopped<PromiseType>) {
+                    if (mylib::get_stop_token_of(h.promise()).stop_requested()) {
+                        return h.promise().unhandled_stopped();
+                    }
+                }
+                return h;
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+    } // namespace mylib::details
+
+    // co_await get_stop_token() gives the stop token inherited by the current coroutine
+    inline details::get_stop_token_awaiter get_stop_token() noexcept { return {}; }
+
+    // co_await stop_checkpoint() completes the current coroutine through the stopped path
+    // if stop was requested, otherwise continues right away
+    inline details::stop_checkpoint_awaiter stop_checkpoint() noexcept { return {}; }
+
     class cancellation_task
     {
     public:
-        struct promise_type
+        struct promise_type : mylib::details::pooled_frame
         {
             cancellation_task get_return_object() noexcept {
                 return cancellation_task(std::coroutine_handle<promise_type>::from_promise(*this));
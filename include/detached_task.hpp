@@ -1,13 +1,19 @@
 #ifndef MYLIB_DETACHED_TASK_H
 #define MYLIB_DETACHED_TASK_H 1
 
+#include <atomic>
+#include <concepts>
 #include <coroutine>
+#include <cstddef>
 #include <exception>
 #include <memory>
+#include <type_traits>
 #include <utility>
 
 #include <cassert>
 
+#include "frame_allocator.hpp"
+
 namespace mylib {
 
     namespace details {
@@ -16,8 +22,104 @@ namespace mylib {
         template<typename TaskType>
         struct detached_task_promise;
 
+        // Queue node kept in every detached promise, used once the task has failed
+        struct detached_failure
+        {
+            detached_failure* next = nullptr;
+            std::coroutine_handle<> frame = nullptr;
+            std::exception_ptr exception;
+        };
+
     } // namespace mylib::details
 
+    // Collects detached tasks exiting with an exception, in place of throwing out of resume().
+    // While a sink is installed on a thread, a detached task failing there keeps its frame and
+    // pushes it onto the sink, a lock-free multi-producer stack. A consumer then reaps the frames
+    // in batches, destroying each after handing its exception on.
+    // Without a sink the task throws detached_task_unhandled_exit_exception as before.
+    class detached_error_sink
+    {
+    public:
+        detached_error_sink() noexcept = default;
+
+        detached_error_sink(const detached_error_sink&) = delete;
+        detached_error_sink& operator=(const detached_error_sink&) = delete;
+
+        // Frames still queued are destroyed, their exceptions dropped
+        ~detached_error_sink() {
+            this->reap([](std::exception_ptr) noexcept {});
+        }
+
+        // Sink installed on the calling thread, null if none
+        static detached_error_sink* current() noexcept { return installed; }
+
+        // Installs a sink on the calling thread while alive, the previous one is restored after
+        class [[nodiscard]] scoped_install
+        {
+        public:
+            explicit scoped_install(detached_error_sink& sink) noexcept
+                : previous(std::exchange(installed, &sink))
+            {}
+
+            scoped_install(const scoped_install&) = delete;
+            scoped_install& operator=(const scoped_install&) = delete;
+
+            ~scoped_install() { installed = this->previous; }
+
+        private:
+            detached_error_sink* previous;
+        };
+
+        bool empty() const noexcept {
+            return this->head.load(std::memory_order_relaxed) == nullptr;
+        }
+
+        // Destroy every frame queued so far, oldest first, passing its exception to on_error.
+        // One consumer at a time. If on_error throws, the frames not reaped yet stay queued.
+        template<std::invocable<std::exception_ptr> OnError>
+        std::size_t reap(OnError&& on_error) {
+            details::detached_failure* reversed = this->head.exchange(nullptr, std::memory_order_acquire);
+            details::detached_failure* batch = nullptr;
+            while (reversed) {
+                details::detached_failure* f = std::exchange(reversed, reversed->next);
+                f->next = batch;
+                batch = f;
+            }
+            std::size_t reaped = 0;
+            while (batch) {
+                details::detached_failure* f = std::exchange(batch, batch->next);
+                std::exception_ptr e = std::move(f->exception);
+                // The node goes away with the frame
+                f->frame.destroy();
+                ++reaped;
+                try {
+                    on_error(std::move(e));
+                } catch (...) {
+                    while (batch) {
+                        this->push(*std::exchange(batch, batch->next));
+                    }
+                    throw;
+                }
+            }
+            return reaped;
+        }
+
+    private:
+        template<typename TaskType>
+        friend struct details::detached_task_promise;
+
+        void push(details::detached_failure& f) noexcept {
+            details::detached_failure* h = this->head.load(std::memory_order_relaxed);
+            do {
+                f.next = h;
+            } while (!this->head.compare_exchange_weak(h, &f, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        std::atomic<details::detached_failure*> head = nullptr;
+
+        static inline thread_local constinit detached_error_sink* installed = nullptr;
+    };
+
     // thrown when detached task exits with unhandled exception
     // nested exception is the exception thrown by the detached task
     // responsible for destroying the coroutine
@@ -60,16 +162,38 @@ namespace mylib {
         inline std::coroutine_handle<> detached_task_stopped(std::coroutine_handle<>) noexcept;
 
         template<typename TaskType>
-        struct detached_task_promise
+        struct detached_task_promise : mylib::details::pooled_frame
         {
             using task_type = TaskType;
             using handle_type = std::coroutine_handle<detached_task_promise>;
             task_type get_return_object() noexcept { return task_type(handle_type::from_promise(*this)); }
             void return_void() const noexcept {}
             std::suspend_always initial_suspend() const noexcept { return {}; }
-            std::suspend_never final_suspend() const noexcept { return {}; } // coroutine destroyed on final suspend
+
+            // Coroutine destroyed on final suspend, unless it failed into a sink
+            struct final_awaiter
+            {
+                bool await_ready() const noexcept { return !this->promise->failure.exception; }
+
+                // Pushed last, the frame may be reaped on another thread right away
+                void await_suspend(std::coroutine_handle<> h) const noexcept {
+                    this->promise->failure.frame = h;
+                    detached_error_sink::current()->push(this->promise->failure);
+                }
+
+                constexpr void await_resume() const noexcept {}
+
+                detached_task_promise* promise;
+            };
+
+            final_awaiter final_suspend() noexcept { return { this }; }
 
             void unhandled_exception() noexcept(false) {
+                if (detached_error_sink::current()) {
+                    // Final suspend follows on this thread, which still has the sink installed
+                    this->failure.exception = std::current_exception();
+                    return;
+                }
                 // propagate exception to caller, executor, or whatever
                 throw detached_task_unhandled_exit_exception(handle_type::from_promise(*this));
             }
@@ -77,6 +201,8 @@ namespace mylib {
             std::coroutine_handle<> unhandled_stopped() noexcept {
                 return detached_task_stopped(handle_type::from_promise(*this));
             }
+
+            detached_failure failure;
         };
 
     } // namespace mylib::details
@@ -126,13 +252,110 @@ namespace mylib {
 
     namespace details {
 
-        inline detached_task cleanup(std::coroutine_handle<> handle) {
-            handle.destroy();
-            co_return;
-        }
+        // Destroys frames completing stopped, outside of the stop chain still running inside them.
+        // One coroutine per thread with its frame in static storage, so no stop path allocates:
+        // a stopped handler queues its frame and returns the reaper, which once resumed destroys
+        // the frame, then goes on with what the queued function gives.
+        // Handles returned by stopped handlers are resumed right away on the thread which got them,
+        // so nested reaps complete last in, first out.
+        class frame_reaper
+        {
+        public:
+            using then_fn = std::coroutine_handle<>(*)(void* context) noexcept;
+
+            static std::coroutine_handle<> nothing(void*) noexcept { return std::noop_coroutine(); }
+
+            static std::coroutine_handle<> reap(std::coroutine_handle<> frame,
+                then_fn then = &nothing, void* context = nullptr) noexcept
+            {
+                frame_reaper& self = local();
+                if (self.depth == max_depth) {
+                    // Nested deeper than anything real, and nothing may allocate here
+                    assert(false && "frame_reaper nested deeper than max_depth!");
+                    std::terminate();
+                }
+                self.pending[self.depth++] = { frame, then, context };
+                return self.handle;
+            }
+
+        private:
+            constexpr static std::size_t max_depth = 8;
+            constexpr static std::size_t frame_size = 128;
+
+            struct entry
+            {
+                std::coroutine_handle<> frame;
+                then_fn then;
+                void* context;
+            };
+
+            struct loop
+            {
+                struct promise_type
+                {
+                    static void* operator new(std::size_t size, frame_reaper& owner) {
+                        if (size > frame_size) {
+                            assert(false && "frame_reaper frame larger than reserved, raise frame_size!");
+                            std::terminate();
+                        }
+                        return owner.storage;
+                    }
+
+                    static void operator delete(void*, std::size_t) noexcept {}
+
+                    loop get_return_object() noexcept { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+                    std::suspend_always initial_suspend() const noexcept { return {}; }
+                    std::suspend_always final_suspend() const noexcept { return {}; }
+                    void return_void() const noexcept {}
+                    [[noreturn]] void unhandled_exception() const noexcept { std::terminate(); }
+                };
+
+                std::coroutine_handle<promise_type> handle;
+            };
+
+            struct reap_next
+            {
+                constexpr bool await_ready() const noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept {
+                    const entry e = this->owner->pending[--this->owner->depth];
+                    e.frame.destroy();
+                    return e.then(e.context);
+                }
+
+                constexpr void await_resume() const noexcept {}
+
+                frame_reaper* owner;
+            };
+
+            frame_reaper() : handle(run(*this).handle) {}
+
+            frame_reaper(const frame_reaper&) = delete;
+            frame_reaper& operator=(const frame_reaper&) = delete;
+
+            // Trivially destructible, so the first stop on a thread registers no exit handler,
+            // which would allocate. The loop frame lives in storage and owns nothing to free.
+            static frame_reaper& local() noexcept {
+                thread_local frame_reaper reaper;
+                return reaper;
+            }
+
+            static loop run(frame_reaper& self) {
+                for (;;) {
+                    co_await reap_next{ &self };
+                }
+            }
+
+            alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) std::byte storage[frame_size];
+            std::coroutine_handle<> handle;
+            entry pending[max_depth];
+            std::size_t depth = 0;
+        };
+
+        static_assert(std::is_trivially_destructible_v<frame_reaper>);
 
         inline std::coroutine_handle<> detached_task_stopped(std::coroutine_handle<> handle) noexcept {
-            return cleanup(handle).to_handle();
+            return frame_reaper::reap(handle);
         }
 
     } // namespace mylib::details
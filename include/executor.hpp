@@ -0,0 +1,19 @@
+#ifndef MYLIB_EXECUTOR_H
+#define MYLIB_EXECUTOR_H 1
+
+#include <concepts>
+#include <coroutine>
+
+namespace mylib {
+
+    // An executor resumes enqueued coroutines on its own execution resources,
+    // and offers co_await ex.schedule() to move the awaiting coroutine there.
+    template<typename Executor>
+    concept executor = requires (Executor& ex, std::coroutine_handle<> h) {
+        ex.enqueue(h);
+        ex.schedule();
+    };
+
+} // namespace mylib
+
+#endif // MYLIB_EXECUTOR_H
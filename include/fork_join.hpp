@@ -0,0 +1,398 @@
+#ifndef MYLIB_FORK_JOIN_H
+#define MYLIB_FORK_JOIN_H 1
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "frame_allocator.hpp"
+#include "symmetric_task_storage.hpp"
+#include "thread_pool.hpp"
+
+namespace mylib {
+
+    // Forward declaration
+    template<typename ReturnType>
+    class fork_join_task;
+
+    namespace details {
+
+        // Join state every fork_join frame carries for the children it spawned,
+        // and where it reports to once spawned itself
+        struct fork_join_frame
+        {
+            using joined_fn = std::coroutine_handle<>(*)(fork_join_frame& self) noexcept;
+            using settle_fn = void(*)(fork_join_frame& self, bool deliver);
+
+            // A child is done, or the frame itself reached a join.
+            // Whoever comes last goes on with what joined gives.
+            std::coroutine_handle<> arrive() noexcept {
+                if (this->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    return this->joined(*this);
+                }
+                return std::noop_coroutine();
+            }
+
+            // First failure wins, published by the release in arrive
+            void fail(std::exception_ptr e) noexcept {
+                if (!this->failed.exchange(true, std::memory_order_relaxed)) {
+                    this->failure = std::move(e);
+                }
+            }
+
+            std::exception_ptr take_failure() noexcept {
+                if (!this->failed.load(std::memory_order_relaxed)) {
+                    return nullptr;
+                }
+                this->failed.store(false, std::memory_order_relaxed);
+                return std::exchange(this->failure, nullptr);
+            }
+
+            // A spawned child is done, its frame kept for the next sync, before it arrives
+            void push_done(fork_join_frame& child) noexcept {
+                child.next_done = this->done.load(std::memory_order_relaxed);
+                while (!this->done.compare_exchange_weak(child.next_done, &child,
+                    std::memory_order_release, std::memory_order_relaxed)) {}
+            }
+
+            // Once all children arrived: hand their results over to their slots, or drop them
+            // when the slots are gone, and free their frames. Rethrows the first failed hand-over.
+            void settle_done(bool deliver) {
+                fork_join_frame* child = this->done.exchange(nullptr, std::memory_order_acquire);
+                std::exception_ptr e;
+                while (child) {
+                    fork_join_frame* next = child->next_done;
+                    try {
+                        child->settle(*child, deliver);
+                    } catch (...) {
+                        if (!e) {
+                            e = std::current_exception();
+                        }
+                    }
+                    child = next;
+                }
+                if (e) {
+                    std::rethrow_exception(std::move(e));
+                }
+            }
+
+            // No child spawned since the last sync is left running or unsettled
+            bool synced() const noexcept {
+                return this->pending.load(std::memory_order_acquire) == 1
+                    && !this->done.load(std::memory_order_relaxed);
+            }
+
+            // Children outstanding, plus one held by the frame itself until it joins
+            std::atomic<std::size_t> pending = 1;
+            std::atomic<bool> failed = false;
+            std::exception_ptr failure;
+            joined_fn joined = nullptr;
+            // Children done since the last sync, their results still in their frames
+            std::atomic<fork_join_frame*> done = nullptr;
+
+            // Set once spawned: the spawning frame, its result slot, and whether
+            // its continuation was pushed where thieves can take it
+            fork_join_frame* parent = nullptr;
+            void* out = nullptr;
+            bool offered = false;
+            // Set once done: next in the parent's done list, and how the parent settles this frame
+            fork_join_frame* next_done = nullptr;
+            settle_fn settle = nullptr;
+            // Spawning or awaiting coroutine
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+        };
+
+    } // namespace mylib::details
+
+    template<typename ReturnType>
+    struct [[nodiscard]] spawn_request
+    {
+        fork_join_task<ReturnType> task;
+        ReturnType* out = nullptr;
+    };
+
+    struct [[nodiscard]] sync_request {};
+
+    namespace details {
+
+        template<typename ReturnType>
+        class fork_join_promise :
+            public fork_join_frame,
+            public mylib::symmetric_task_storage<ReturnType>,
+            public mylib::details::pooled_frame
+        {
+        public:
+            using return_type = ReturnType;
+            using task_type = mylib::fork_join_task<return_type>;
+            using handle_type = std::coroutine_handle<fork_join_promise>;
+
+            // inherited from symmetric_task_storage:
+            // unhandled_exception
+            // return_value or return_void
+            // do_resume
+            // inherited from pooled_frame:
+            // operator new, operator delete
+
+            // A body which returned has synced all its children, so their results reached its locals.
+            // One which threw still waits for the children running, then drops their results.
+            struct [[nodiscard]] final_awaiter
+            {
+                bool await_ready() const noexcept { return false; }
+
+                template<typename PromiseType>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> current) noexcept {
+                    fork_join_promise& p = static_cast<fork_join_promise&>(current.promise());
+                    if (!p.has_exception() && !p.synced()) {
+                        assert(false && "fork_join_task returned without a sync after its last spawn!");
+                        std::terminate();
+                    }
+                    p.joined = &complete;
+                    return p.arrive();
+                }
+
+                void await_resume() const noexcept { std::unreachable(); }
+            };
+
+            struct [[nodiscard]] sync_awaiter
+            {
+                bool await_ready() const noexcept {
+                    return this->promise->pending.load(std::memory_order_acquire) == 1;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept {
+                    this->promise->joined = &resume_joined;
+                    return this->promise->arrive();
+                }
+
+                void await_resume() const {
+                    this->promise->pending.store(1, std::memory_order_relaxed);
+                    std::exception_ptr e = this->promise->take_failure();
+                    try {
+                        this->promise->settle_done(true);
+                    } catch (...) {
+                        if (!e) {
+                            e = std::current_exception();
+                        }
+                    }
+                    if (e) {
+                        std::rethrow_exception(std::move(e));
+                    }
+                }
+
+                fork_join_promise* promise;
+            };
+
+            template<typename ChildReturnType>
+            struct [[nodiscard]] spawn_awaiter
+            {
+                constexpr bool await_ready() const noexcept { return false; }
+
+                // Once the continuation is pushed a thief may resume this coroutine and free
+                // the awaiter, so nothing of it is touched after
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> current) const noexcept {
+                    const std::coroutine_handle<> child = this->child;
+                    fork_join_frame& c = this->child.promise();
+                    c.parent = this->promise;
+                    c.out = this->out;
+                    c.continuation = current;
+                    this->promise->pending.fetch_add(1, std::memory_order_relaxed);
+                    if (thread_pool* pool = thread_pool::current()) {
+                        c.offered = true;
+                        try {
+                            pool->enqueue(current);
+                        } catch (...) {
+                            // Deque could not grow, the child resumes us itself
+                            c.offered = false;
+                        }
+                    }
+                    return child;
+                }
+
+                constexpr void await_resume() const noexcept {}
+
+                fork_join_promise* promise;
+                typename mylib::fork_join_task<ChildReturnType>::handle_type child;
+                void* out;
+            };
+
+            task_type get_return_object() noexcept { return task_type(handle_type::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            final_awaiter final_suspend() noexcept { return {}; }
+
+            template<typename ChildReturnType>
+            spawn_awaiter<ChildReturnType> await_transform(spawn_request<ChildReturnType> request) noexcept {
+                return { this, std::move(request.task).to_handle(), request.out };
+            }
+
+            sync_awaiter await_transform(sync_request) noexcept { return { this }; }
+
+            // Forwarding transform
+            template<typename T>
+            T&& await_transform(T&& awaitable) noexcept {
+                return static_cast<T&&>(awaitable);
+            }
+
+        private:
+            static std::coroutine_handle<> resume_joined(fork_join_frame& f) noexcept {
+                return handle_type::from_promise(static_cast<fork_join_promise&>(f));
+            }
+
+            // Runs once body and children are all done. An awaited frame resumes its awaiter,
+            // which owns it. A spawned one queues itself for the parent's next sync, which takes
+            // its result and frees it, and goes back to the parent: straight into the continuation
+            // if no thief took it meanwhile, else through the parent's counter.
+            static std::coroutine_handle<> complete(fork_join_frame& f) noexcept {
+                fork_join_promise& p = static_cast<fork_join_promise&>(f);
+                // Left only by a body which threw, the slots of these results are gone
+                f.settle_done(false);
+                if (std::exception_ptr e = f.take_failure(); e && !p.has_exception()) {
+                    p.unhandled_exception(std::move(e));
+                }
+                if (!f.parent) {
+                    return f.continuation;
+                }
+                fork_join_frame& parent = *f.parent;
+                const std::coroutine_handle<> continuation = f.continuation;
+                const bool offered = f.offered;
+                if (p.has_exception()) {
+                    parent.fail(p.take_exception());
+                    f.out = nullptr;
+                }
+                f.settle = &settle;
+                // From here on the parent may settle this frame as soon as its count allows
+                parent.push_done(f);
+                if (!offered) {
+                    parent.pending.fetch_sub(1, std::memory_order_acq_rel);
+                    return continuation;
+                }
+                if (thread_pool* pool = thread_pool::current()) {
+                    if (std::coroutine_handle<> h = pool->take_local()) {
+                        if (h == continuation) {
+                            // Still ours, so the parent has not reached a join and is not last
+                            parent.pending.fetch_sub(1, std::memory_order_acq_rel);
+                            return continuation;
+                        }
+                        // Resumed elsewhere we popped unrelated work, put it back
+                        pool->enqueue(h);
+                    }
+                }
+                return parent.arrive();
+            }
+
+            // Called by the parent at sync, the frame is freed even if the assignment throws
+            static void settle(fork_join_frame& f, bool deliver) {
+                fork_join_promise& p = static_cast<fork_join_promise&>(f);
+                const handle_type h = handle_type::from_promise(p);
+                if constexpr (!std::is_void_v<return_type>) {
+                    if (deliver && f.out) {
+                        try {
+                            *static_cast<return_type*>(f.out) = p.do_resume();
+                        } catch (...) {
+                            h.destroy();
+                            throw;
+                        }
+                    }
+                }
+                h.destroy();
+            }
+        };
+
+    } // namespace mylib::details
+
+    // Task for recursive divide-and-conquer work on a thread_pool, Cilk style.
+    // spawn runs the child first and leaves the spawning coroutine's continuation on the worker's
+    // deque: an idle worker steals it and runs on in parallel, otherwise the child resumes it
+    // directly when done. So a worker holds one deque entry per spawn nesting level, never
+    // a backlog of unstarted children. sync joins all children through one counter in the frame,
+    // and must follow the last spawn before the body returns. A body which throws instead
+    // still waits for its children before completing, dropping their results.
+    // Off the pool, spawn degrades to a plain call. Awaited with co_await, it runs as a normal task.
+    // Completing stopped is not supported.
+    template<typename ReturnType>
+    class [[nodiscard]] fork_join_task
+    {
+    public:
+        using return_type = ReturnType;
+        using promise_type = details::fork_join_promise<return_type>;
+        using handle_type = typename promise_type::handle_type;
+        friend promise_type;
+
+        fork_join_task(const fork_join_task&) = delete;
+        fork_join_task& operator=(const fork_join_task&) = delete;
+
+        fork_join_task(fork_join_task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+        fork_join_task& operator=(fork_join_task&& other) noexcept {
+            fork_join_task().swap(other);
+            return *this;
+        }
+
+        void swap(fork_join_task& other) noexcept {
+            if (this == std::addressof(other)) return;
+            std::ranges::swap(this->coroutine, other.coroutine);
+        }
+
+        ~fork_join_task() { if (this->coroutine) { this->coroutine.destroy(); } }
+
+        [[nodiscard]]
+        handle_type to_handle() && noexcept { return std::exchange(this->coroutine, nullptr); }
+
+        class [[nodiscard]] task_awaiter
+        {
+        public:
+            task_awaiter(const task_awaiter&) = delete;
+            task_awaiter& operator=(const task_awaiter&) = delete;
+
+            ~task_awaiter() { if (this->coroutine) { this->coroutine.destroy(); } }
+
+            [[nodiscard]] bool await_ready() noexcept { return !this->coroutine; }
+
+            handle_type await_suspend(std::coroutine_handle<> current) noexcept {
+                this->coroutine.promise().continuation = current;
+                return this->coroutine;
+            }
+
+            return_type await_resume() { return this->coroutine.promise().do_resume(); }
+
+        private:
+            friend fork_join_task;
+            explicit task_awaiter(handle_type handle) noexcept : coroutine(handle) {}
+
+            handle_type coroutine = nullptr;
+        };
+
+        task_awaiter operator co_await() && noexcept {
+            return task_awaiter(std::exchange(this->coroutine, nullptr));
+        }
+
+    private:
+        fork_join_task() = default;
+        explicit fork_join_task(handle_type handle) noexcept : coroutine(handle) {}
+
+        handle_type coroutine = nullptr;
+    };
+
+    // co_await spawn(child, slot) inside a fork_join_task starts child at once on this thread,
+    // and leaves the rest of the spawning coroutine for any idle worker to steal.
+    // The child keeps its result in its own frame until the next sync assigns it to slot.
+    template<typename ReturnType>
+        requires (!std::is_reference_v<ReturnType> && !std::is_void_v<ReturnType>)
+    spawn_request<ReturnType> spawn(fork_join_task<ReturnType>&& task, ReturnType& out) noexcept {
+        return { std::move(task), std::addressof(out) };
+    }
+
+    inline spawn_request<void> spawn(fork_join_task<void>&& task) noexcept {
+        return { std::move(task) };
+    }
+
+    // co_await sync() inside a fork_join_task waits for every child spawned so far, assigns
+    // their results to their slots, then rethrows the first exception any of them exited with
+    inline sync_request sync() noexcept { return {}; }
+
+} // namespace mylib
+
+#endif // MYLIB_FORK_JOIN_H
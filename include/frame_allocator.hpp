@@ -0,0 +1,303 @@
+#ifndef MYLIB_FRAME_ALLOCATOR_H
+#define MYLIB_FRAME_ALLOCATOR_H 1
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <cassert>
+
+namespace mylib {
+
+    namespace details {
+
+        // Thread-local recycling pool for coroutine frames, bucketed by size class.
+        // A frame freed on another thread simply goes to the freeing thread's cache,
+        // so blocks never need to find their way back and no synchronization is involved.
+        // Buckets are bounded, so producer/consumer thread pairs cannot hoard memory.
+        class frame_pool
+        {
+        public:
+            constexpr static std::size_t granularity = 64;
+            constexpr static std::size_t class_count = 16; // frames up to 1 KiB are recycled
+            constexpr static std::size_t max_cached = 64; // per size class
+
+            static void* allocate(std::size_t size) {
+                const std::size_t c = size_class(size);
+                if (c >= class_count) {
+                    return ::operator new(size);
+                }
+                bucket& b = buckets[c];
+                if (free_block* block = b.head) {
+                    b.head = block->next;
+                    --b.count;
+                    return block;
+                }
+                return ::operator new(class_size(c));
+            }
+
+            static void deallocate(void* p, std::size_t size) noexcept {
+                const std::size_t c = size_class(size);
+                if (c >= class_count) {
+                    ::operator delete(p, size);
+                    return;
+                }
+                bucket& b = buckets[c];
+                if (b.count >= max_cached || !enter()) {
+                    ::operator delete(p, class_size(c));
+                    return;
+                }
+                b.head = ::new (p) free_block{ b.head };
+                ++b.count;
+            }
+
+        private:
+            struct free_block { free_block* next; };
+
+            struct bucket
+            {
+                free_block* head;
+                std::size_t count;
+            };
+
+            enum class cache_state { unused, live, dead };
+
+            // Returns cached blocks to the global heap when the thread exits.
+            struct thread_guard
+            {
+                ~thread_guard() {
+                    state = cache_state::dead;
+                    for (std::size_t c = 0; c < class_count; ++c) {
+                        bucket& b = buckets[c];
+                        while (free_block* block = b.head) {
+                            b.head = block->next;
+                            ::operator delete(block, class_size(c));
+                        }
+                        b.count = 0;
+                    }
+                }
+            };
+
+            constexpr static std::size_t size_class(std::size_t size) noexcept {
+                return (size - 1) / granularity;
+            }
+
+            constexpr static std::size_t class_size(std::size_t c) noexcept {
+                return (c + 1) * granularity;
+            }
+
+            // Frames freed during thread teardown bypass the cache.
+            static bool enter() noexcept {
+                if (state == cache_state::live) [[likely]] {
+                    return true;
+                }
+                if (state == cache_state::dead) {
+                    return false;
+                }
+                thread_local thread_guard guard;
+                state = cache_state::live;
+                return true;
+            }
+
+            static inline thread_local constinit bucket buckets[class_count]{};
+            static inline thread_local constinit cache_state state = cache_state::unused;
+        };
+
+        // Signature of the function stored right behind every frame which knows how to free it.
+        using frame_deallocate_fn = void(*)(void* frame, std::size_t size) noexcept;
+
+        constexpr std::size_t align_up(std::size_t n, std::size_t align) noexcept {
+            return (n + align - 1) & ~(align - 1);
+        }
+
+        constexpr std::size_t frame_trailer_offset(std::size_t size) noexcept {
+            return align_up(size, alignof(frame_deallocate_fn));
+        }
+
+        constexpr std::size_t frame_trailer_end(std::size_t size) noexcept {
+            return frame_trailer_offset(size) + sizeof(frame_deallocate_fn);
+        }
+
+        inline void* set_frame_deallocate(void* frame, std::size_t size, frame_deallocate_fn fn) noexcept {
+            ::new (static_cast<std::byte*>(frame) + frame_trailer_offset(size)) frame_deallocate_fn(fn);
+            return frame;
+        }
+
+        inline frame_deallocate_fn get_frame_deallocate(void* frame, std::size_t size) noexcept {
+            return *std::launder(reinterpret_cast<frame_deallocate_fn*>(
+                static_cast<std::byte*>(frame) + frame_trailer_offset(size)
+            ));
+        }
+
+        inline void pool_frame_deallocate(void* frame, std::size_t size) noexcept {
+            frame_pool::deallocate(frame, frame_trailer_end(size));
+        }
+
+        // Frames of coroutines called with leading std::allocator_arg, alloc.
+        // A copy of the allocator is kept behind the trailer unless it is stateless.
+        template<typename Alloc>
+        struct allocator_frame
+        {
+            struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) block {
+                std::byte bytes[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+            };
+
+            using block_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<block>;
+            using traits = std::allocator_traits<block_allocator>;
+
+            constexpr static bool stateless = traits::is_always_equal::value
+                && std::is_default_constructible_v<block_allocator>;
+
+            constexpr static std::size_t allocator_offset(std::size_t size) noexcept {
+                return align_up(frame_trailer_end(size), alignof(block_allocator));
+            }
+
+            constexpr static std::size_t block_count(std::size_t size) noexcept {
+                const std::size_t total = stateless
+                    ? frame_trailer_end(size)
+                    : allocator_offset(size) + sizeof(block_allocator);
+                return (total + sizeof(block) - 1) / sizeof(block);
+            }
+
+            static void* allocate(const Alloc& alloc, std::size_t size) {
+                block_allocator a(alloc);
+                void* frame = std::to_address(traits::allocate(a, block_count(size)));
+                if constexpr (!stateless) {
+                    ::new (static_cast<std::byte*>(frame) + allocator_offset(size)) block_allocator(std::move(a));
+                }
+                return set_frame_deallocate(frame, size, &deallocate);
+            }
+
+            static void deallocate(void* frame, std::size_t size) noexcept {
+                if constexpr (stateless) {
+                    block_allocator a{};
+                    traits::deallocate(a, static_cast<block*>(frame), block_count(size));
+                } else {
+                    block_allocator* stored = std::launder(reinterpret_cast<block_allocator*>(
+                        static_cast<std::byte*>(frame) + allocator_offset(size)
+                    ));
+                    block_allocator a(std::move(*stored));
+                    stored->~block_allocator();
+                    traits::deallocate(a, static_cast<block*>(frame), block_count(size));
+                }
+            }
+        };
+
+    } // namespace mylib::details
+
+    // Request-scoped arena for coroutine frames.
+    // While an arena is alive, every frame created on its thread without an explicit allocator
+    // is bump-allocated from it; freeing such a frame is a no-op and all chunks are released
+    // at once when the arena goes out of scope. Every frame created inside the scope must be
+    // destroyed before the scope ends. Arenas nest; the innermost one is used.
+    // The scope must not span a co_await: while the installing coroutine is suspended, frames of
+    // unrelated work on its thread would land in the arena, and it could end on another thread.
+    // Coroutines that suspend should pass an allocator through std::allocator_arg instead.
+    class frame_arena
+    {
+    public:
+        constexpr static std::size_t default_chunk_size = 16 * 1024;
+
+        explicit frame_arena(std::size_t chunk_size = default_chunk_size) noexcept
+            : chunk_size(chunk_size), previous(std::exchange(current_arena, this))
+        {}
+
+        frame_arena(const frame_arena&) = delete;
+        frame_arena& operator=(const frame_arena&) = delete;
+
+        ~frame_arena() {
+            assert(current_arena == this && "frame_arena ended on another thread or out of order!");
+            current_arena = this->previous;
+            while (chunk* c = this->chunks) {
+                this->chunks = c->next;
+                ::operator delete(c, c->size);
+            }
+        }
+
+        [[nodiscard]]
+        static frame_arena* current() noexcept { return current_arena; }
+
+        void* allocate(std::size_t size) {
+            size = details::align_up(size, alignment);
+            if (size > static_cast<std::size_t>(this->end - this->cursor)) [[unlikely]] {
+                return this->allocate_chunk(size);
+            }
+            return std::exchange(this->cursor, this->cursor + size);
+        }
+
+    private:
+        constexpr static std::size_t alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+        struct alignas(alignment) chunk
+        {
+            chunk* next;
+            std::size_t size;
+        };
+
+        std::byte* allocate_chunk(std::size_t size) {
+            const std::size_t bytes = sizeof(chunk) + std::max(size, this->chunk_size);
+            chunk* c = ::new (::operator new(bytes)) chunk{ this->chunks, bytes };
+            this->chunks = c;
+            std::byte* payload = reinterpret_cast<std::byte*>(c + 1);
+            if (size < this->chunk_size) {
+                // Keep bumping from the fresh chunk; an oversized frame gets a chunk of its own
+                this->cursor = payload + size;
+                this->end = payload + this->chunk_size;
+            }
+            return payload;
+        }
+
+        static inline thread_local constinit frame_arena* current_arena = nullptr;
+
+        std::size_t chunk_size;
+        frame_arena* previous;
+        chunk* chunks = nullptr;
+        std::byte* cursor = nullptr;
+        std::byte* end = nullptr;
+    };
+
+    namespace details {
+
+        inline void arena_frame_deallocate(void*, std::size_t) noexcept {}
+
+        // Promise types inherit from this to control how their frames are allocated.
+        // By default frames come from frame_pool, or from the current frame_arena if any.
+        // A coroutine whose leading parameters
+        // are std::allocator_arg, alloc (after the object parameter for member coroutines)
+        // allocates its frame from alloc instead.
+        struct pooled_frame
+        {
+            static void* operator new(std::size_t size) {
+                if (mylib::frame_arena* arena = mylib::frame_arena::current()) {
+                    return set_frame_deallocate(
+                        arena->allocate(frame_trailer_end(size)), size, &arena_frame_deallocate
+                    );
+                }
+                return set_frame_deallocate(
+                    frame_pool::allocate(frame_trailer_end(size)), size, &pool_frame_deallocate
+                );
+            }
+
+            template<typename Alloc, typename... Args>
+            static void* operator new(std::size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...) {
+                return allocator_frame<Alloc>::allocate(alloc, size);
+            }
+
+            template<typename This, typename Alloc, typename... Args>
+            static void* operator new(std::size_t size, const This&, std::allocator_arg_t, const Alloc& alloc, const Args&...) {
+                return allocator_frame<Alloc>::allocate(alloc, size);
+            }
+
+            static void operator delete(void* p, std::size_t size) noexcept {
+                get_frame_deallocate(p, size)(p, size);
+            }
+        };
+
+    } // namespace mylib::details
+
+} // namespace mylib
+
+#endif // MYLIB_FRAME_ALLOCATOR_H
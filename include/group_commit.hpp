@@ -0,0 +1,185 @@
+#ifndef MYLIB_GROUP_COMMIT_H
+#define MYLIB_GROUP_COMMIT_H 1
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+#include <cassert>
+
+#include "detached_task.hpp"
+#include "timer_wheel.hpp"
+#include "transaction.hpp"
+
+namespace mylib {
+
+    // Transactional adapter coalescing the commits of concurrent transactions on one resource.
+    // Begin and rollback go to the resource as they are; a commit waits for the batch instead,
+    // and one transaction_commit of the resource then completes every commit of the batch.
+    // For resources whose commit makes all work done so far durable at once, such as an fsync.
+    // A batch is committed once max_batch commits wait, once window elapsed since its first commit
+    // if a timer_wheel is given, or on flush().
+    template<mylib::transactional Resource>
+    class group_commit : private timer_entry
+    {
+    public:
+        using resource_type = Resource;
+        using duration = timer_wheel::duration;
+
+        class [[nodiscard]] commit_awaiter;
+
+        explicit group_commit(resource_type& resource, std::size_t max_batch) noexcept
+            : timer_entry(&on_window), resource(&resource), max_batch(max_batch)
+        {
+            assert(max_batch > 0 && "Batch size must be positive.");
+        }
+
+        group_commit(resource_type& resource, std::size_t max_batch, timer_wheel& wheel, duration window) noexcept
+            : group_commit(resource, max_batch)
+        {
+            this->wheel = &wheel;
+            this->window = window;
+        }
+
+        group_commit(const group_commit&) = delete;
+        group_commit& operator=(const group_commit&) = delete;
+
+        ~group_commit() {
+            assert(this->waiting == 0 && "Commits still waiting for their batch.");
+        }
+
+        decltype(auto) transaction_begin() { return mylib::transaction_begin(*this->resource); }
+
+        decltype(auto) transaction_rollback() { return mylib::transaction_rollback(*this->resource); }
+
+        commit_awaiter transaction_commit() noexcept { return commit_awaiter(*this); }
+
+        // Commit whatever waits now, without waiting for the batch to fill or the window to elapse.
+        // If the commit cannot even be started, every commit of the batch fails with the error.
+        void flush() {
+            if (commit_awaiter* batch = this->take_batch()) {
+                try {
+                    commit_batch(*this, batch).start();
+                } catch (...) {
+                    complete_batch(batch, std::current_exception());
+                }
+            }
+        }
+
+        std::size_t pending() const noexcept {
+            std::scoped_lock lock(this->mutex);
+            return this->waiting;
+        }
+
+        resource_type& underlying() const noexcept { return *this->resource; }
+
+    private:
+        // Queue w, and hand back the batch if w fills it
+        commit_awaiter* enqueue(commit_awaiter& w) noexcept {
+            std::scoped_lock lock(this->mutex);
+            *this->tail = &w;
+            this->tail = &w.next;
+            if (++this->waiting < this->max_batch) {
+                if (this->waiting == 1 && this->wheel) {
+                    this->wheel->arm(*this, timer_wheel::clock::now() + this->window);
+                }
+                return nullptr;
+            }
+            return this->take_batch_locked();
+        }
+
+        commit_awaiter* take_batch() noexcept {
+            std::scoped_lock lock(this->mutex);
+            return this->take_batch_locked();
+        }
+
+        commit_awaiter* take_batch_locked() noexcept {
+            if (this->wheel) {
+                this->wheel->cancel(*this);
+            }
+            this->waiting = 0;
+            this->tail = &this->head;
+            return std::exchange(this->head, nullptr);
+        }
+
+        static void on_window(timer_entry& e) {
+            static_cast<group_commit&>(e).flush();
+        }
+
+        // One commit of the resource for the whole batch, which shares its outcome
+        static mylib::detached_task commit_batch(group_commit& self, commit_awaiter* batch) {
+            std::exception_ptr failure;
+            try {
+                co_await mylib::transaction_commit(*self.resource);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            complete_batch(batch, failure);
+        }
+
+        // Resume the commits of batch up to last excluded, with failure if any
+        static void complete_batch(commit_awaiter* batch, std::exception_ptr failure, commit_awaiter* last = nullptr) noexcept {
+            while (batch != last) {
+                // Resuming destroys the awaiter
+                commit_awaiter* w = std::exchange(batch, batch->next);
+                w->failure = failure;
+                w->continuation.resume();
+            }
+        }
+
+        mutable std::mutex mutex;
+        resource_type* resource;
+        std::size_t max_batch;
+        timer_wheel* wheel = nullptr;
+        duration window{};
+        commit_awaiter* head = nullptr;
+        commit_awaiter** tail = &head;
+        std::size_t waiting = 0;
+    };
+
+    template<mylib::transactional Resource>
+    class [[nodiscard]] group_commit<Resource>::commit_awaiter
+    {
+    public:
+        commit_awaiter(const commit_awaiter&) = delete;
+        commit_awaiter& operator=(const commit_awaiter&) = delete;
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            this->continuation = h;
+            // May be resumed on another thread right away, do not touch this from here on
+            if (commit_awaiter* batch = this->owner->enqueue(*this)) {
+                try {
+                    return commit_batch(*this->owner, batch).to_handle();
+                } catch (...) {
+                    // Filling the batch this comes last in it: the others fail, this one rethrows
+                    complete_batch(batch, std::current_exception(), this);
+                    throw;
+                }
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const {
+            if (this->failure) {
+                std::rethrow_exception(this->failure);
+            }
+        }
+
+    private:
+        friend group_commit;
+
+        explicit commit_awaiter(group_commit& owner) noexcept : owner(&owner) {}
+
+        group_commit* owner;
+        commit_awaiter* next = nullptr;
+        std::coroutine_handle<> continuation = nullptr;
+        std::exception_ptr failure;
+    };
+
+} // namespace mylib
+
+#endif // MYLIB_GROUP_COMMIT_H
@@ -0,0 +1,331 @@
+#ifndef MYLIB_IO_URING_REACTOR_H
+#define MYLIB_IO_URING_REACTOR_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace mylib {
+
+    class io_uring_reactor;
+
+    namespace details {
+
+        class unique_fd
+        {
+        public:
+            unique_fd() noexcept = default;
+            explicit unique_fd(int fd) noexcept : fd(fd) {}
+
+            unique_fd(unique_fd&& other) noexcept : fd(std::exchange(other.fd, -1)) {}
+            unique_fd& operator=(unique_fd&& other) noexcept {
+                std::ranges::swap(this->fd, other.fd);
+                return *this;
+            }
+
+            ~unique_fd() { if (this->fd >= 0) { ::close(this->fd); } }
+
+            int get() const noexcept { return this->fd; }
+
+        private:
+            int fd = -1;
+        };
+
+        // Shared read-write mapping of one ring region, unmapped on destruction
+        class unique_mapping
+        {
+        public:
+            unique_mapping() noexcept = default;
+
+            unique_mapping(int fd, std::size_t size, std::uint64_t offset)
+                : data(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, static_cast<off_t>(offset)))
+                , size(size)
+            {
+                if (this->data == MAP_FAILED) {
+                    this->data = nullptr;
+                    throw std::system_error(errno, std::system_category(), "io_uring mmap");
+                }
+            }
+
+            unique_mapping(unique_mapping&& other) noexcept
+                : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0))
+            {}
+
+            unique_mapping& operator=(unique_mapping&& other) noexcept {
+                std::ranges::swap(this->data, other.data);
+                std::ranges::swap(this->size, other.size);
+                return *this;
+            }
+
+            ~unique_mapping() { if (this->data) { ::munmap(this->data, this->size); } }
+
+            void* get() const noexcept { return this->data; }
+
+        private:
+            void* data = nullptr;
+            std::size_t size = 0;
+        };
+
+    } // namespace mylib::details
+
+    // Awaiter of one io_uring operation. The prepared submission entry and the completion
+    // result live in the awaiter, i.e. in the awaiting coroutine frame; the completion
+    // resumes the stored handle directly. Errors are thrown as std::system_error.
+    class [[nodiscard]] io_operation
+    {
+    public:
+        // Must not be moved once awaited
+        io_operation(io_operation&&) = default;
+        io_operation& operator=(io_operation&&) = delete;
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h);
+
+        int await_resume() const {
+            if (this->result < 0) {
+                throw std::system_error(-this->result, std::system_category());
+            }
+            return this->result;
+        }
+
+    private:
+        friend io_uring_reactor;
+
+        io_operation(io_uring_reactor& reactor, std::uint8_t opcode, int fd) noexcept
+            : reactor(&reactor)
+        {
+            std::memset(&this->sqe, 0, sizeof(this->sqe));
+            this->sqe.opcode = opcode;
+            this->sqe.fd = fd;
+        }
+
+        io_uring_reactor* reactor;
+        io_uring_sqe sqe;
+        std::coroutine_handle<> continuation = nullptr;
+        int result = 0;
+    };
+
+    // Single-threaded io_uring event loop.
+    // Operations awaited by coroutines are queued as submission entries and handed
+    // to the kernel in one io_uring_enter call by run_once, which then resumes the
+    // coroutines of every completion available in the completion queue.
+    class io_uring_reactor
+    {
+    public:
+        explicit io_uring_reactor(unsigned entries = 256) {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            this->ring_fd = details::unique_fd(static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params)));
+            if (this->ring_fd.get() < 0) {
+                throw std::system_error(errno, std::system_category(), "io_uring_setup");
+            }
+            std::size_t sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            std::size_t cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap) {
+                sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+            }
+            // Members own what is mapped so far, a later failure unmaps it
+            this->sq_map = details::unique_mapping(this->ring_fd.get(), sq_ring_size, IORING_OFF_SQ_RING);
+            if (!single_mmap) {
+                this->cq_map = details::unique_mapping(this->ring_fd.get(), cq_ring_size, IORING_OFF_CQ_RING);
+            }
+            this->sqe_map = details::unique_mapping(this->ring_fd.get(),
+                params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+            this->sqes = static_cast<io_uring_sqe*>(this->sqe_map.get());
+
+            auto* sq = static_cast<std::byte*>(this->sq_map.get());
+            this->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            this->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            this->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            this->sq_entries = params.sq_entries;
+            this->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+            auto* cq = static_cast<std::byte*>(single_mmap ? this->sq_map.get() : this->cq_map.get());
+            this->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            this->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            this->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            this->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            this->local_tail = *this->sq_tail;
+        }
+
+        io_uring_reactor(const io_uring_reactor&) = delete;
+        io_uring_reactor& operator=(const io_uring_reactor&) = delete;
+
+        ~io_uring_reactor() = default;
+
+        // Number of operations submitted or queued whose completion was not reaped yet
+        std::size_t in_flight() const noexcept { return this->outstanding; }
+
+        // Submit queued operations, optionally wait for at least one completion,
+        // then resume every completed operation. Returns the number resumed.
+        std::size_t run_once(bool wait = true) {
+            const unsigned to_submit = this->local_tail - this->submitted_tail;
+            const unsigned min_complete = (wait && this->outstanding > 0 && !this->completions_ready()) ? 1 : 0;
+            if (to_submit > 0 || min_complete > 0) {
+                this->enter(to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+            }
+            return this->reap();
+        }
+
+        io_operation read(int fd, std::span<std::byte> buffer, std::uint64_t offset = -1) noexcept {
+            io_operation op(*this, IORING_OP_READ, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(buffer.data());
+            op.sqe.len = static_cast<std::uint32_t>(buffer.size());
+            op.sqe.off = offset;
+            return op;
+        }
+
+        io_operation write(int fd, std::span<const std::byte> buffer, std::uint64_t offset = -1) noexcept {
+            io_operation op(*this, IORING_OP_WRITE, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(buffer.data());
+            op.sqe.len = static_cast<std::uint32_t>(buffer.size());
+            op.sqe.off = offset;
+            return op;
+        }
+
+        io_operation readv(int fd, std::span<const ::iovec> buffers, std::uint64_t offset = -1) noexcept {
+            io_operation op(*this, IORING_OP_READV, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(buffers.data());
+            op.sqe.len = static_cast<std::uint32_t>(buffers.size());
+            op.sqe.off = offset;
+            return op;
+        }
+
+        io_operation accept(int fd, ::sockaddr* addr = nullptr, ::socklen_t* addrlen = nullptr, int flags = 0) noexcept {
+            io_operation op(*this, IORING_OP_ACCEPT, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+            op.sqe.addr2 = reinterpret_cast<std::uintptr_t>(addrlen);
+            op.sqe.accept_flags = static_cast<std::uint32_t>(flags);
+            return op;
+        }
+
+        io_operation connect(int fd, const ::sockaddr* addr, ::socklen_t addrlen) noexcept {
+            io_operation op(*this, IORING_OP_CONNECT, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+            op.sqe.off = addrlen;
+            return op;
+        }
+
+        io_operation recv(int fd, std::span<std::byte> buffer, int flags = 0) noexcept {
+            io_operation op(*this, IORING_OP_RECV, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(buffer.data());
+            op.sqe.len = static_cast<std::uint32_t>(buffer.size());
+            op.sqe.msg_flags = static_cast<std::uint32_t>(flags);
+            return op;
+        }
+
+        io_operation send(int fd, std::span<const std::byte> buffer, int flags = 0) noexcept {
+            io_operation op(*this, IORING_OP_SEND, fd);
+            op.sqe.addr = reinterpret_cast<std::uintptr_t>(buffer.data());
+            op.sqe.len = static_cast<std::uint32_t>(buffer.size());
+            op.sqe.msg_flags = static_cast<std::uint32_t>(flags);
+            return op;
+        }
+
+    private:
+        friend io_operation;
+
+        void enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+            std::atomic_ref(*this->sq_tail).store(this->local_tail, std::memory_order_release);
+            for (;;) {
+                const long r = ::syscall(__NR_io_uring_enter, this->ring_fd.get(), to_submit, min_complete, flags, nullptr, 0);
+                if (r >= 0) {
+                    this->submitted_tail += static_cast<unsigned>(r);
+                    return;
+                }
+                if (errno != EINTR) {
+                    throw std::system_error(errno, std::system_category(), "io_uring_enter");
+                }
+            }
+        }
+
+        void submit(io_operation* op) {
+            unsigned head = std::atomic_ref(*this->sq_head).load(std::memory_order_acquire);
+            while (this->local_tail - head >= this->sq_entries) {
+                // Ring full, hand the queued entries to the kernel first; it may take only some
+                this->enter(this->local_tail - this->submitted_tail, 0, 0);
+                const unsigned consumed = std::atomic_ref(*this->sq_head).load(std::memory_order_acquire);
+                if (consumed == head) {
+                    throw std::system_error(EBUSY, std::system_category(), "io_uring submission queue full");
+                }
+                head = consumed;
+            }
+            const unsigned index = this->local_tail & this->sq_mask;
+            this->sqes[index] = op->sqe;
+            this->sqes[index].user_data = reinterpret_cast<std::uintptr_t>(op);
+            this->sq_array[index] = index;
+            ++this->local_tail;
+            ++this->outstanding;
+        }
+
+        bool completions_ready() const noexcept {
+            return std::atomic_ref(*this->cq_tail).load(std::memory_order_acquire) != *this->cq_head;
+        }
+
+        std::size_t reap() {
+            std::size_t count = 0;
+            unsigned head = *this->cq_head;
+            const unsigned tail = std::atomic_ref(*this->cq_tail).load(std::memory_order_acquire);
+            while (head != tail) {
+                const io_uring_cqe& cqe = this->cqes[head & this->cq_mask];
+                auto* op = reinterpret_cast<io_operation*>(static_cast<std::uintptr_t>(cqe.user_data));
+                op->result = cqe.res;
+                // Release the slot before resuming, the coroutine may queue more work
+                std::atomic_ref(*this->cq_head).store(++head, std::memory_order_release);
+                --this->outstanding;
+                ++count;
+                op->continuation.resume();
+            }
+            return count;
+        }
+
+        // Declared first, closed after the rings are unmapped
+        details::unique_fd ring_fd;
+        details::unique_mapping sq_map;
+        // Empty when the kernel maps both rings at once
+        details::unique_mapping cq_map;
+        details::unique_mapping sqe_map;
+        io_uring_sqe* sqes = nullptr;
+
+        unsigned* sq_head = nullptr;
+        unsigned* sq_tail = nullptr;
+        unsigned* sq_array = nullptr;
+        unsigned sq_mask = 0;
+        unsigned sq_entries = 0;
+        unsigned local_tail = 0;
+        unsigned submitted_tail = 0;
+
+        unsigned* cq_head = nullptr;
+        unsigned* cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe* cqes = nullptr;
+
+        std::size_t outstanding = 0;
+    };
+
+    inline void io_operation::await_suspend(std::coroutine_handle<> h) {
+        this->continuation = h;
+        this->reactor->submit(this);
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_IO_URING_REACTOR_H
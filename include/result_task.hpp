@@ -0,0 +1,267 @@
+#ifndef MYLIB_RESULT_TASK_H
+#define MYLIB_RESULT_TASK_H 1
+
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <expected>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <cassert>
+
+#include "cancellation.hpp"
+#include "frame_allocator.hpp"
+#include "sync_wait.hpp"
+
+namespace mylib {
+
+    // Forward declaration
+    template<typename ValueType, typename ErrorType>
+    class result_task;
+
+    namespace details {
+
+        // Where a child hands its error instead of resuming its awaiting frame.
+        // forward stores the error in the awaiting frame and returns the coroutine to resume next.
+        struct error_forward
+        {
+            using forward_fn = std::coroutine_handle<>(*)(void* promise, void* error) noexcept;
+
+            void* promise = nullptr;
+            forward_fn forward = nullptr;
+        };
+
+        template<typename ValueType, typename ErrorType>
+        class result_task_promise :
+            public mylib::cancellation_base,
+            public mylib::details::pooled_frame
+        {
+        public:
+            using value_type = ValueType;
+            using error_type = ErrorType;
+            using return_type = std::expected<value_type, error_type>;
+            using task_type = mylib::result_task<value_type, error_type>;
+            using handle_type = std::coroutine_handle<result_task_promise>;
+
+            static_assert(!std::is_reference_v<value_type>, "result_task of reference is not supported.");
+
+            task_type get_return_object() noexcept { return task_type(handle_type::from_promise(*this)); }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct [[nodiscard]] final_awaiter
+            {
+                constexpr bool await_ready() const noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(handle_type current) noexcept {
+                    result_task_promise& p = current.promise();
+                    if (p.has_error()) {
+                        return p.complete_with_error();
+                    }
+                    return p.get_continuation();
+                }
+
+                void await_resume() const noexcept { std::unreachable(); }
+            };
+
+            final_awaiter final_suspend() noexcept { return {}; }
+
+            // co_return value, co_return std::unexpected(error), or co_return expected
+            void return_value(return_type r) noexcept(std::is_nothrow_move_constructible_v<return_type>) {
+                this->storage.template emplace<value>(std::move(r));
+            }
+
+            void unhandled_exception() noexcept {
+                this->storage.template emplace<exception>(std::current_exception());
+            }
+
+            bool has_error() const noexcept {
+                const return_type* r = std::get_if<value>(&this->storage);
+                return r && !r->has_value();
+            }
+
+            return_type do_resume() {
+                if (std::exception_ptr* e = std::get_if<exception>(&this->storage)) {
+                    std::rethrow_exception(*e);
+                }
+                assert(this->storage.index() == value && "Task result is uninitialized.");
+                return std::move(std::get<value>(this->storage));
+            }
+
+            // Value of a child awaited with short-circuit, its error was forwarded otherwise
+            value_type value_or_rethrow() {
+                if constexpr (std::is_void_v<value_type>) {
+                    this->do_resume();
+                } else {
+                    return *this->do_resume();
+                }
+            }
+
+            void set_error_forward(error_forward f) noexcept { this->forward = f; }
+
+            // Awaiting a result_task from a result_task short-circuits its errors: the co_await gives
+            // the value, an error completes this frame with it right away. Awaiting anything else,
+            // including child.as_expected(), is left untouched.
+            template<typename OtherValue, typename OtherError>
+                requires std::constructible_from<error_type, OtherError>
+            auto await_transform(mylib::result_task<OtherValue, OtherError>&& child) noexcept;
+
+            template<typename Awaitable>
+            Awaitable&& await_transform(Awaitable&& a) const noexcept { return std::forward<Awaitable>(a); }
+
+        private:
+            template<typename Promise, typename ChildError>
+            static std::coroutine_handle<> forward_error(void* promise, void* error) noexcept {
+                Promise& p = *static_cast<Promise*>(promise);
+                p.storage.template emplace<value>(std::unexpect, std::move(*static_cast<ChildError*>(error)));
+                return p.complete_with_error();
+            }
+
+            template<typename, typename>
+            friend class result_task_promise;
+
+            // Hand the error on to the frame awaiting this one if it short-circuits too, otherwise
+            // resume that frame, which then reads the error from here.
+            // Frames skipped this way stay suspended at their co_await until their owner destroys them.
+            std::coroutine_handle<> complete_with_error() noexcept {
+                if (this->forward.forward) {
+                    return this->forward.forward(this->forward.promise,
+                        std::addressof(std::get<value>(this->storage).error()));
+                }
+                return this->get_continuation();
+            }
+
+            constexpr static std::size_t value = 1;
+            constexpr static std::size_t exception = 2;
+
+            std::variant<std::monostate, return_type, std::exception_ptr> storage;
+            error_forward forward;
+        };
+
+        template<typename ValueType, typename ErrorType, bool ShortCircuit>
+        class [[nodiscard]] result_task_awaiter
+        {
+        public:
+            using promise_type = result_task_promise<ValueType, ErrorType>;
+            using handle_type = std::coroutine_handle<promise_type>;
+
+            result_task_awaiter(const result_task_awaiter&) = delete;
+            result_task_awaiter& operator=(const result_task_awaiter&) = delete;
+
+            result_task_awaiter(result_task_awaiter&& other) noexcept
+                : coroutine(std::exchange(other.coroutine, nullptr)), forward(other.forward)
+            {}
+
+            ~result_task_awaiter() { if (this->coroutine) { this->coroutine.destroy(); } }
+
+            [[nodiscard]] bool await_ready() const noexcept { return !this->coroutine; }
+
+            template<typename PromiseType>
+            handle_type await_suspend(std::coroutine_handle<PromiseType> current) noexcept {
+                this->coroutine.promise().set_continuation(current);
+                if constexpr (ShortCircuit) {
+                    this->coroutine.promise().set_error_forward(this->forward);
+                }
+                return this->coroutine;
+            }
+
+            auto await_resume() {
+                if constexpr (ShortCircuit) {
+                    return this->coroutine.promise().value_or_rethrow();
+                } else {
+                    return this->coroutine.promise().do_resume();
+                }
+            }
+
+        private:
+            template<typename, typename>
+            friend class mylib::result_task;
+            template<typename, typename>
+            friend class result_task_promise;
+
+            explicit result_task_awaiter(handle_type handle, error_forward forward = {}) noexcept
+                : coroutine(handle), forward(forward)
+            {}
+
+            handle_type coroutine = nullptr;
+            error_forward forward;
+        };
+
+    } // namespace mylib::details
+
+    // Task with an error channel that never throws.
+    // Awaited from any coroutine it gives std::expected<ValueType, ErrorType>. Awaited from another
+    // result_task it gives ValueType, and an error skips straight to the awaiting frame's own result,
+    // frame after frame, until it reaches a frame awaiting with as_expected() or a non-result_task.
+    // Exceptions still work as in task and are rethrown at every level.
+    template<typename ValueType, typename ErrorType>
+    class [[nodiscard]] result_task
+    {
+    public:
+        using value_type = ValueType;
+        using error_type = ErrorType;
+        using return_type = std::expected<value_type, error_type>;
+        using promise_type = details::result_task_promise<value_type, error_type>;
+        using handle_type = std::coroutine_handle<promise_type>;
+        using task_awaiter = details::result_task_awaiter<value_type, error_type, false>;
+
+        result_task(const result_task&) = delete;
+        result_task& operator=(const result_task&) = delete;
+
+        result_task(result_task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+        result_task& operator=(result_task&& other) noexcept {
+            result_task(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(result_task& other) noexcept {
+            std::ranges::swap(this->coroutine, other.coroutine);
+        }
+
+        ~result_task() { if (this->coroutine) { this->coroutine.destroy(); } }
+
+        task_awaiter operator co_await() && noexcept {
+            return task_awaiter(std::exchange(this->coroutine, nullptr));
+        }
+
+        // Opt out of short-circuit inside a result_task, co_await gives the std::expected
+        task_awaiter as_expected() && noexcept {
+            return task_awaiter(std::exchange(this->coroutine, nullptr));
+        }
+
+        return_type sync_await() && {
+            return mylib::sync_wait(std::move(*this));
+        }
+
+    private:
+        friend promise_type;
+        template<typename, typename>
+        friend class details::result_task_promise;
+
+        explicit result_task(handle_type handle) noexcept : coroutine(handle) {}
+
+        handle_type coroutine = nullptr;
+    };
+
+    namespace details {
+
+        template<typename ValueType, typename ErrorType>
+        template<typename OtherValue, typename OtherError>
+            requires std::constructible_from<ErrorType, OtherError>
+        auto result_task_promise<ValueType, ErrorType>::await_transform(
+            mylib::result_task<OtherValue, OtherError>&& child) noexcept
+        {
+            return result_task_awaiter<OtherValue, OtherError, true>(
+                std::exchange(child.coroutine, nullptr),
+                error_forward{ this, &forward_error<result_task_promise, OtherError> }
+            );
+        }
+
+    } // namespace mylib::details
+
+} // namespace mylib
+
+#endif // MYLIB_RESULT_TASK_H
@@ -5,6 +5,7 @@
 #include <type_traits>
 
 #include "detached_task.hpp"
+#include "executor.hpp"
 #include "symmetric_task_storage.hpp"
 
 namespace mylib {
@@ -28,6 +29,30 @@ namespace mylib {
 
     fork_return() -> fork_return<void>;
 
+    // As fork_return, and the rest of the coroutine is then enqueued on executor
+    // instead of waiting for someone to resume it
+    template<mylib::executor Executor, typename T>
+    struct fork_return_on
+    {
+        using type = T;
+        Executor& executor;
+        T&& value;
+    };
+
+    template<mylib::executor Executor, typename Void>
+        requires (std::is_void_v<Void>)
+    struct fork_return_on<Executor, Void>
+    {
+        using type = Void;
+        Executor& executor;
+    };
+
+    template<mylib::executor Executor, typename T>
+    fork_return_on(Executor&, T&&) -> fork_return_on<Executor, T>;
+
+    template<mylib::executor Executor>
+    fork_return_on(Executor&) -> fork_return_on<Executor, void>;
+
     namespace details {
 
         template<typename TaskType>
@@ -75,6 +100,27 @@ namespace mylib {
                 return {};
             }
 
+            // The tail is enqueued by the parent once it has taken the result,
+            // since the tail may run to completion and free the frame right away
+            template<typename Executor, typename T>
+            fork_return_awaiter await_transform(fork_return_on<Executor, T> fr) noexcept {
+                if constexpr (std::is_void_v<T>) {
+                    this->await_transform(fork_return<T>{});
+                } else {
+                    this->await_transform(fork_return<T>{ static_cast<T&&>(fr.value) });
+                }
+                this->tail_executor = std::addressof(fr.executor);
+                this->post_tail_fn = &post_to<Executor>;
+                return {};
+            }
+
+            // Enqueue the tail if fork_return_on asked for it
+            void post_tail() {
+                if (this->post_tail_fn) {
+                    this->post_tail_fn(this->tail_executor, handle_type::from_promise(*this));
+                }
+            }
+
             // Forwarding transform
             template<typename T>
             T&& await_transform(T&& awaitable) noexcept
@@ -85,8 +131,17 @@ namespace mylib {
             void set_continuation(std::coroutine_handle<> c) noexcept { continuation = c; }
 
         private:
+            using post_fn = void(*)(void* executor, std::coroutine_handle<> tail);
+
+            template<typename Executor>
+            static void post_to(void* executor, std::coroutine_handle<> tail) {
+                static_cast<Executor*>(executor)->enqueue(tail);
+            }
+
             symmetric_storage storage;
             std::coroutine_handle<> continuation = std::noop_coroutine();
+            void* tail_executor = nullptr;
+            post_fn post_tail_fn = nullptr;
         };
 
     } // namespace mylib::details
@@ -140,9 +195,31 @@ namespace mylib {
                 return this->coroutine;
             }
 
-            return_type await_resume() { return this->coroutine.promise().do_resume(); }
+            // Frame must not be touched once the tail is posted
+            return_type await_resume() {
+                auto& promise = this->coroutine.promise();
+                if constexpr (std::is_void_v<return_type>) {
+                    promise.do_resume();
+                    this->post_tail();
+                } else {
+                    return_type result = promise.do_resume();
+                    this->post_tail();
+                    return static_cast<return_type>(result);
+                }
+            }
 
         private:
+            // An executor refusing the tail leaves it to nobody: the frame is freed,
+            // and the error rethrown in place of the result
+            void post_tail() {
+                try {
+                    this->coroutine.promise().post_tail();
+                } catch (...) {
+                    this->coroutine.destroy();
+                    throw;
+                }
+            }
+
             friend task_type;
             explicit task_awaiter(handle_type handle) noexcept : coroutine(handle) {}
 
@@ -0,0 +1,259 @@
+#ifndef MYLIB_STOP_TOKEN_H
+#define MYLIB_STOP_TOKEN_H 1
+
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace mylib {
+
+    class inplace_stop_source;
+    class inplace_stop_token;
+
+    template<typename Callback>
+    class inplace_stop_callback;
+
+    namespace details {
+
+        // Intrusive node of the callback list of an inplace_stop_source
+        struct stop_callback_base
+        {
+            using execute_fn = void(*)(stop_callback_base&) noexcept;
+
+            execute_fn execute;
+            stop_callback_base* next = nullptr;
+            // Null once taken off the list by request_stop
+            stop_callback_base** prev_ptr = nullptr;
+            bool* removed_during_callback = nullptr;
+            std::atomic<bool> callback_completed = false;
+        };
+
+    } // namespace mylib::details
+
+    // Stop source with no allocation: callbacks are linked into the source from storage of
+    // their own, registration and deregistration are O(1) under a tiny spin lock.
+    // Same contract as std::stop_source, non-movable since tokens and callbacks point to it.
+    class inplace_stop_source
+    {
+    public:
+        inplace_stop_source() = default;
+
+        inplace_stop_source(const inplace_stop_source&) = delete;
+        inplace_stop_source& operator=(const inplace_stop_source&) = delete;
+
+        ~inplace_stop_source() {
+            assert(this->callbacks == nullptr && "Stop source destroyed with registered callbacks.");
+        }
+
+        inline inplace_stop_token get_token() const noexcept;
+
+        bool stop_requested() const noexcept {
+            return (this->state.load(std::memory_order_acquire) & stop_requested_flag) != 0;
+        }
+
+        // Run every registered callback on the calling thread, returns false if stop was already requested
+        bool request_stop() noexcept {
+            if (!this->lock_unless_stopped(true)) {
+                return false;
+            }
+            this->notifying_thread = std::this_thread::get_id();
+            while (details::stop_callback_base* cb = this->callbacks) {
+                this->callbacks = cb->next;
+                if (this->callbacks) {
+                    this->callbacks->prev_ptr = &this->callbacks;
+                }
+                cb->prev_ptr = nullptr;
+                this->unlock();
+
+                bool removed = false;
+                cb->removed_during_callback = &removed;
+                cb->execute(*cb);
+                if (!removed) {
+                    cb->removed_during_callback = nullptr;
+                    cb->callback_completed.store(true, std::memory_order_release);
+                    cb->callback_completed.notify_all();
+                }
+                this->lock();
+            }
+            this->unlock();
+            return true;
+        }
+
+    private:
+        template<typename>
+        friend class inplace_stop_callback;
+
+        constexpr static std::uint8_t stop_requested_flag = 1;
+        constexpr static std::uint8_t locked_flag = 2;
+
+        void lock() noexcept {
+            std::uint8_t s = this->state.load(std::memory_order_relaxed);
+            for (;;) {
+                while (s & locked_flag) {
+                    std::this_thread::yield();
+                    s = this->state.load(std::memory_order_relaxed);
+                }
+                if (this->state.compare_exchange_weak(s, s | locked_flag,
+                    std::memory_order_acquire, std::memory_order_relaxed)) {
+                    return;
+                }
+            }
+        }
+
+        bool lock_unless_stopped(bool set_stop) noexcept {
+            std::uint8_t s = this->state.load(std::memory_order_relaxed);
+            for (;;) {
+                if (s & stop_requested_flag) {
+                    return false;
+                }
+                if (s & locked_flag) {
+                    std::this_thread::yield();
+                    s = this->state.load(std::memory_order_relaxed);
+                    continue;
+                }
+                const std::uint8_t desired = locked_flag | (set_stop ? stop_requested_flag : 0);
+                if (this->state.compare_exchange_weak(s, desired,
+                    std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+        }
+
+        void unlock() noexcept {
+            this->state.fetch_and(static_cast<std::uint8_t>(~locked_flag), std::memory_order_release);
+        }
+
+        // False if stop was already requested, the callback is then not registered
+        bool try_add_callback(details::stop_callback_base& cb) noexcept {
+            if (!this->lock_unless_stopped(false)) {
+                return false;
+            }
+            cb.next = this->callbacks;
+            cb.prev_ptr = &this->callbacks;
+            if (this->callbacks) {
+                this->callbacks->prev_ptr = &cb.next;
+            }
+            this->callbacks = &cb;
+            this->unlock();
+            return true;
+        }
+
+        // Once this returns the callback is not running and will never run
+        void remove_callback(details::stop_callback_base& cb) noexcept {
+            this->lock();
+            if (cb.prev_ptr) {
+                *cb.prev_ptr = cb.next;
+                if (cb.next) {
+                    cb.next->prev_ptr = cb.prev_ptr;
+                }
+                this->unlock();
+                return;
+            }
+            const std::thread::id notifier = this->notifying_thread;
+            this->unlock();
+            if (notifier == std::this_thread::get_id()) {
+                // Destroyed from inside its own callback, or after it on the requesting thread
+                if (cb.removed_during_callback) {
+                    *cb.removed_during_callback = true;
+                }
+            } else {
+                while (!cb.callback_completed.load(std::memory_order_acquire)) {
+                    cb.callback_completed.wait(false, std::memory_order_acquire);
+                }
+            }
+        }
+
+        std::atomic<std::uint8_t> state = 0;
+        details::stop_callback_base* callbacks = nullptr;
+        std::thread::id notifying_thread;
+    };
+
+    // Cheap copyable view of an inplace_stop_source, or of nothing when default constructed
+    class inplace_stop_token
+    {
+    public:
+        template<typename Callback>
+        using callback_type = inplace_stop_callback<Callback>;
+
+        inplace_stop_token() = default;
+
+        bool stop_requested() const noexcept {
+            return this->source != nullptr && this->source->stop_requested();
+        }
+
+        bool stop_possible() const noexcept { return this->source != nullptr; }
+
+        friend bool operator==(const inplace_stop_token&, const inplace_stop_token&) = default;
+
+        void swap(inplace_stop_token& other) noexcept {
+            std::ranges::swap(this->source, other.source);
+        }
+
+    private:
+        friend inplace_stop_source;
+        template<typename>
+        friend class inplace_stop_callback;
+
+        explicit inplace_stop_token(const inplace_stop_source* source) noexcept : source(source) {}
+
+        const inplace_stop_source* source = nullptr;
+    };
+
+    inline inplace_stop_token inplace_stop_source::get_token() const noexcept {
+        return inplace_stop_token(this);
+    }
+
+    // Callback invoked once when stop is requested, on the requesting thread,
+    // or right away in the constructor if stop was already requested.
+    // Lives wherever it is declared, typically in an awaiter inside the awaiting frame.
+    template<typename Callback>
+    class inplace_stop_callback : private details::stop_callback_base
+    {
+    public:
+        template<typename Init>
+            requires std::constructible_from<Callback, Init>
+        explicit inplace_stop_callback(inplace_stop_token token, Init&& init)
+            noexcept(std::is_nothrow_constructible_v<Callback, Init>)
+            : details::stop_callback_base{ &execute_impl }, callback(std::forward<Init>(init))
+        {
+            if (token.source == nullptr) {
+                return;
+            }
+            this->source = const_cast<inplace_stop_source*>(token.source);
+            if (!this->source->try_add_callback(*this)) {
+                this->source = nullptr;
+                if (token.stop_requested()) {
+                    std::invoke(std::move(this->callback));
+                }
+            }
+        }
+
+        inplace_stop_callback(const inplace_stop_callback&) = delete;
+        inplace_stop_callback& operator=(const inplace_stop_callback&) = delete;
+
+        ~inplace_stop_callback() {
+            if (this->source) {
+                this->source->remove_callback(*this);
+            }
+        }
+
+    private:
+        static void execute_impl(details::stop_callback_base& cb) noexcept {
+            std::invoke(std::move(static_cast<inplace_stop_callback&>(cb).callback));
+        }
+
+        inplace_stop_source* source = nullptr;
+        Callback callback;
+    };
+
+    template<typename Callback>
+    inplace_stop_callback(inplace_stop_token, Callback) -> inplace_stop_callback<Callback>;
+
+} // namespace mylib
+
+#endif // MYLIB_STOP_TOKEN_H
@@ -3,6 +3,7 @@
 
 #include <concepts>
 #include <cstddef>
+#include <memory>
 #include <variant>
 #include <exception>
 
@@ -33,6 +34,12 @@ namespace mylib {
                 self.storage.template emplace<exception>(std::move(e));
             }
 
+            // Move the stored exception out, to hand it on without rethrowing
+            exception_type take_exception(this auto&& self) noexcept {
+                assert(self.storage.index() == exception && "Task has no exception.");
+                return std::move(*std::get_if<exception>(&self.storage));
+            }
+
             std::size_t index(this auto&& self) noexcept {
                 return self.storage.index();
             }
@@ -108,6 +115,77 @@ namespace mylib {
         storage_type storage;
     };
 
+    // Storage for tasks that never throw: a bare slot tagged by one bool,
+    // an exception escaping the coroutine body terminates.
+    template<typename ReturnType>
+    class nothrow_task_storage
+    {
+    public:
+        using return_type = ReturnType;
+    private:
+        constexpr static bool return_reference = std::is_reference_v<return_type>;
+    public:
+        using data_type = std::conditional_t<return_reference, std::add_pointer_t<return_type>, return_type>;
+
+        nothrow_task_storage() noexcept {}
+
+        nothrow_task_storage(const nothrow_task_storage&) = delete;
+        nothrow_task_storage& operator=(const nothrow_task_storage&) = delete;
+
+        ~nothrow_task_storage() {
+            if (this->engaged) {
+                std::destroy_at(std::addressof(this->data));
+            }
+        }
+
+        [[noreturn]] void unhandled_exception() noexcept { std::terminate(); }
+
+        void return_value(return_type rt) noexcept requires (return_reference) {
+            std::construct_at(std::addressof(this->data), std::addressof(rt));
+            this->engaged = true;
+        }
+
+        template<typename U = return_type>
+            requires (not return_reference) && std::convertible_to<U, return_type> && std::constructible_from<return_type, U>
+        void return_value(U&& rt) noexcept(std::is_nothrow_constructible_v<return_type, U>) {
+            std::construct_at(std::addressof(this->data), std::forward<U>(rt));
+            this->engaged = true;
+        }
+
+        bool uninitialized() const noexcept { return !this->engaged; }
+        constexpr bool has_exception() const noexcept { return false; }
+        bool has_value() const noexcept { return this->engaged; }
+
+        return_type do_resume() noexcept(return_reference || std::is_nothrow_move_constructible_v<return_type>) {
+            assert(this->engaged && "Task result is uninitialized.");
+            if constexpr (return_reference) {
+                return static_cast<return_type>(*this->data);
+            } else {
+                return std::move(this->data);
+            }
+        }
+
+    private:
+        union { data_type data; };
+        bool engaged = false;
+    };
+
+    template<typename Void>
+        requires (std::is_void_v<Void>)
+    class nothrow_task_storage<Void>
+    {
+    public:
+        using return_type = void;
+
+        [[noreturn]] void unhandled_exception() noexcept { std::terminate(); }
+
+        void return_void() noexcept {}
+
+        constexpr bool has_exception() const noexcept { return false; }
+
+        void do_resume() noexcept {}
+    };
+
 } // namespace mylib
 
 #endif // MYLIB_SYMMETRIC_TASK_PROMISE_H
@@ -0,0 +1,148 @@
+#ifndef MYLIB_SYNC_WAIT_H
+#define MYLIB_SYNC_WAIT_H 1
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "awaitable_traits.hpp"
+#include "symmetric_task_storage.hpp"
+
+namespace mylib {
+
+    // thrown by sync_wait when the awaited operation completes through the stopped path
+    class sync_wait_stopped_exception : public std::exception
+    {
+    public:
+        const char* what() const noexcept override { return "Awaited operation stopped."; }
+    };
+
+    namespace details {
+
+        struct sync_wait_state
+        {
+            constexpr static std::size_t buffer_size = 256;
+
+            // Notified under the lock: the waiter cannot return, and destroy this state,
+            // before the signalling thread lets go of the mutex, its last access
+            void signal(bool s) noexcept {
+                std::scoped_lock lock(this->mutex);
+                this->stopped = s;
+                this->done = true;
+                this->cv.notify_one();
+            }
+
+            void wait() noexcept {
+                std::unique_lock lock(this->mutex);
+                this->cv.wait(lock, [this] { return this->done; });
+            }
+
+            // The driver frame lives here unless it does not fit
+            alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) std::byte buffer[buffer_size];
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+            bool stopped = false;
+        };
+
+        template<typename ReturnType>
+        class [[nodiscard]] sync_wait_task
+        {
+        public:
+            struct promise_type : mylib::symmetric_task_storage<ReturnType>
+            {
+                template<typename... Args>
+                promise_type(sync_wait_state& state, Args&&...) noexcept : state(&state) {}
+
+                template<typename... Args>
+                static void* operator new(std::size_t size, sync_wait_state& state, const Args&...) {
+                    if (size <= sync_wait_state::buffer_size) {
+                        return state.buffer;
+                    }
+                    return ::operator new(size);
+                }
+
+                static void operator delete(void* p, std::size_t size) noexcept {
+                    if (size > sync_wait_state::buffer_size) {
+                        ::operator delete(p, size);
+                    }
+                }
+
+                sync_wait_task get_return_object() noexcept {
+                    return sync_wait_task(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() noexcept { return {}; }
+
+                struct final_awaiter
+                {
+                    bool await_ready() const noexcept { return false; }
+
+                    // The waiting thread may destroy the frame as soon as it is signaled
+                    void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                        h.promise().state->signal(false);
+                    }
+
+                    void await_resume() const noexcept { std::unreachable(); }
+                };
+
+                final_awaiter final_suspend() noexcept { return {}; }
+
+                std::coroutine_handle<> unhandled_stopped() noexcept {
+                    this->state->signal(true);
+                    return std::noop_coroutine();
+                }
+
+                sync_wait_state* state;
+            };
+
+            using handle_type = std::coroutine_handle<promise_type>;
+
+            sync_wait_task(const sync_wait_task&) = delete;
+            sync_wait_task& operator=(const sync_wait_task&) = delete;
+
+            ~sync_wait_task() { this->handle.destroy(); }
+
+            void start() noexcept { this->handle.resume(); }
+
+            ReturnType result() {
+                if (this->handle.promise().state->stopped) {
+                    throw mylib::sync_wait_stopped_exception();
+                }
+                return this->handle.promise().do_resume();
+            }
+
+        private:
+            explicit sync_wait_task(handle_type handle) noexcept : handle(handle) {}
+
+            handle_type handle;
+        };
+
+        template<typename ReturnType, typename Awaitable>
+        sync_wait_task<ReturnType> sync_wait_driver(sync_wait_state&, Awaitable&& a) {
+            co_return co_await std::forward<Awaitable>(a);
+        }
+
+    } // namespace mylib::details
+
+    // Block the calling thread until the awaitable completes, then return its result or rethrow.
+    // The awaitable may complete on any thread; the caller parks on a condition variable meanwhile.
+    // Entry point from non-coroutine code, never call it from a thread the awaitable needs to progress.
+    template<typename Awaitable>
+    details::await_result_t<Awaitable> sync_wait(Awaitable&& a) {
+        using return_type = details::await_result_t<Awaitable>;
+        details::sync_wait_state state;
+        details::sync_wait_task<return_type> driver =
+            details::sync_wait_driver<return_type>(state, std::forward<Awaitable>(a));
+        driver.start();
+        state.wait();
+        return driver.result();
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_SYNC_WAIT_H
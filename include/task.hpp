@@ -2,30 +2,69 @@
 #define MYLIB_COROUTINE_TASK_H 1
 
 #include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
 #include <utility>
 #include <memory>
 
 #include "symmetric_task_storage.hpp"
 #include "cancellation.hpp"
+#include "frame_allocator.hpp"
+#include "sync_wait.hpp"
+#include "task_policy.hpp"
 
 namespace mylib {
 
     namespace details {
+
+        // Completion hook of a task started by a combinator such as when_all.
+        // The task reports to it in place of resuming a continuation.
+        struct task_join
+        {
+            using complete_fn = std::coroutine_handle<>(*)(task_join& join, std::size_t index, bool stopped) noexcept;
+
+            complete_fn complete;
+        };
+
+        // Where a child hands its exception instead of resuming its awaiting frame, given the
+        // awaiting frame's address. Returns the coroutine to resume next.
+        using exception_forward_fn = std::coroutine_handle<>(*)(void* frame, std::exception_ptr e) noexcept;
+
+        struct no_exception_forward {};
+
+        // Combinator a task was started by, with its index there
+        struct task_join_slot
+        {
+            task_join* join = nullptr;
+            std::size_t index = 0;
+        };
+
+        struct no_task_join_slot {};
+
+        template<typename TaskType>
+        class task_awaiter;
     
         template<typename TaskType>
         class task_promise :
-            public mylib::symmetric_task_storage<typename TaskType::return_type>,
-            public mylib::cancellation_base
+            public details::policy_storage_t<typename TaskType::return_type, typename TaskType::policy_type>,
+            public details::policy_continuation_t<typename TaskType::policy_type>,
+            public mylib::details::pooled_frame
         {
         public:
             using task_type = TaskType;
             using handle_type = std::coroutine_handle<task_promise>;
             using return_type = typename task_type::return_type;
+            using policy_type = typename task_type::policy_type;
 
-            // inherited from symmetric_task_storage:
+            // inherited from symmetric_task_storage or nothrow_task_storage, per policy:
             // unhandled_exception
             // return_value or return_void
             // do_resume
+            // inherited from cancellation_base or continuation_base, per policy:
+            // set_continuation, get_continuation, and stop token access if cancellable
+            // inherited from pooled_frame:
+            // operator new, operator delete
 
             struct [[nodiscard]] final_awaiter
             {
@@ -33,7 +72,18 @@ namespace mylib {
 
                 template<typename PromiseType>
                 std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> current_coroutine) noexcept {
-                    return static_cast<task_promise&>(current_coroutine.promise()).get_continuation();
+                    task_promise& p = static_cast<task_promise&>(current_coroutine.promise());
+                    if constexpr (joinable) {
+                        if (p.join.join) {
+                            return p.complete_join(false);
+                        }
+                    }
+                    if constexpr (policy_type::exceptions) {
+                        if (p.forward && p.has_exception()) {
+                            return p.forward(p.get_continuation().address(), p.take_exception());
+                        }
+                    }
+                    return p.get_continuation();
                 }
 
                 void await_resume() const noexcept { std::unreachable(); }
@@ -42,6 +92,58 @@ namespace mylib {
             task_type get_return_object() { return task_type(handle_type::from_promise(*this)); }
             std::suspend_always initial_suspend() noexcept { return {}; }
             final_awaiter final_suspend() noexcept { return {}; }
+
+            std::coroutine_handle<> unhandled_stopped() noexcept requires (policy_type::cancellation) {
+                if constexpr (joinable) {
+                    if (this->join.join) {
+                        return this->complete_join(true);
+                    }
+                }
+                return this->cancellation_base::unhandled_stopped();
+            }
+
+            // Whether the task can be started by a combinator, see task_policy.hpp
+            constexpr static bool joinable = details::policy_joinable<policy_type>;
+
+            void set_join(task_join& j, std::size_t index) noexcept requires (joinable) {
+                this->join = { &j, index };
+            }
+
+            constexpr static bool forwards_exceptions = details::policy_forwards_exceptions<policy_type>;
+
+            void set_exception_forward(exception_forward_fn f) noexcept requires (policy_type::exceptions) {
+                this->forward = f;
+            }
+
+        private:
+            template<typename>
+            friend class task_awaiter;
+
+            // Take over the exception of an awaited child as this frame's own and complete at once,
+            // leaving this frame suspended at its co_await until its owner destroys it.
+            template<typename Promise>
+            static std::coroutine_handle<> forward_exception(void* frame, std::exception_ptr e) noexcept {
+                Promise& p = std::coroutine_handle<Promise>::from_address(frame).promise();
+                if constexpr (Promise::joinable) {
+                    if (p.join.join) {
+                        p.unhandled_exception(std::move(e));
+                        return p.complete_join(false);
+                    }
+                }
+                if (p.forward) {
+                    return p.forward(p.get_continuation().address(), std::move(e));
+                }
+                p.unhandled_exception(std::move(e));
+                return p.get_continuation();
+            }
+
+            std::coroutine_handle<> complete_join(bool stopped) noexcept {
+                return this->join.join->complete(*this->join.join, this->join.index, stopped);
+            }
+
+            [[no_unique_address]] std::conditional_t<joinable, task_join_slot, no_task_join_slot> join{};
+            [[no_unique_address]] std::conditional_t<policy_type::exceptions,
+                exception_forward_fn, no_exception_forward> forward{};
         };
 
         template<typename TaskType>
@@ -75,15 +177,46 @@ namespace mylib {
             template<typename PromiseType>
             handle_type await_suspend(std::coroutine_handle<PromiseType> current) noexcept {
                 this->coroutine.promise().set_continuation(current);
+                if constexpr (task_type::policy_type::exceptions && forwards_exceptions_to<PromiseType>) {
+                    this->coroutine.promise().set_exception_forward(
+                        &PromiseType::template forward_exception<PromiseType>);
+                }
                 return this->coroutine;
             }
 
             return_type await_resume() { return this->coroutine.promise().do_resume(); }
 
+            // Start the task as child index of a combinator instead of awaiting it;
+            // await_resume gives the result once join was told of completion
+            void start_joined(task_join& join, std::size_t index, mylib::inplace_stop_token token) noexcept
+                requires (task_type::promise_type::joinable)
+            {
+                this->coroutine.promise().set_join(join, index);
+                if constexpr (task_type::policy_type::cancellation) {
+                    this->coroutine.promise().set_stop_token(token);
+                }
+                this->coroutine.resume();
+            }
+
+            // Replace the stop token the task inherited, between await_suspend and its resumption
+            void set_stop_token(mylib::inplace_stop_token token) noexcept requires (task_type::policy_type::cancellation) {
+                this->coroutine.promise().set_stop_token(token);
+            }
+
         private:
             friend task_type;
             explicit task_awaiter(handle_type handle) noexcept : coroutine(handle) {}
 
+            // Awaiting frame takes over exceptions of this task without rethrowing them
+            template<typename PromiseType>
+            constexpr static bool forwards_exceptions_to = [] {
+                if constexpr (requires { PromiseType::forwards_exceptions; }) {
+                    return PromiseType::forwards_exceptions;
+                } else {
+                    return false;
+                }
+            }();
+
             task_awaiter() = default;
 
             handle_type coroutine = nullptr;
@@ -91,11 +224,13 @@ namespace mylib {
 
     } // namespace mylib::details
 
-    template<typename ReturnType>
+    // Policy strips what the promise has to carry, see task_policy.hpp
+    template<typename ReturnType, task_policy Policy = default_task_policy>
     class [[nodiscard]] task
     {
     public:
         using return_type = ReturnType;
+        using policy_type = Policy;
         using promise_type = details::task_promise<task>;
         using handle_type = typename promise_type::handle_type;
         using task_awaiter = details::task_awaiter<task>;
@@ -120,11 +255,9 @@ namespace mylib {
             return task_awaiter(std::exchange(this->coroutine, nullptr));
         }
 
-        // Test only
+        // Same as mylib::sync_wait(std::move(task))
         return_type sync_await() && {
-            task_awaiter awaiter = std::move(*this).operator co_await();
-            awaiter.await_suspend(std::noop_coroutine()).resume();
-            return awaiter.await_resume();
+            return mylib::sync_wait(std::move(*this));
         }
 
     private:
@@ -135,6 +268,43 @@ namespace mylib {
         handle_type coroutine = nullptr;
     };
 
+    namespace details {
+
+        template<typename TaskAwaiter>
+        class [[nodiscard]] stop_token_awaiter
+        {
+        public:
+            stop_token_awaiter(mylib::inplace_stop_token token, TaskAwaiter&& awaiter) noexcept
+                : token(token), awaiter(std::move(awaiter))
+            {}
+
+            bool await_ready() noexcept { return this->awaiter.await_ready(); }
+
+            template<typename PromiseType>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> current) noexcept {
+                std::coroutine_handle<> child = this->awaiter.await_suspend(current);
+                this->awaiter.set_stop_token(this->token);
+                return child;
+            }
+
+            decltype(auto) await_resume() { return this->awaiter.await_resume(); }
+
+        private:
+            mylib::inplace_stop_token token;
+            TaskAwaiter awaiter;
+        };
+
+    } // namespace mylib::details
+
+    // co_await with_stop_token(token, t) runs t with token in place of the one of the awaiting coroutine
+    template<typename ReturnType, task_policy Policy>
+        requires (Policy::cancellation)
+    auto with_stop_token(mylib::inplace_stop_token token, mylib::task<ReturnType, Policy>&& t) noexcept {
+        return details::stop_token_awaiter<typename mylib::task<ReturnType, Policy>::task_awaiter>(
+            token, std::move(t).operator co_await()
+        );
+    }
+
 } // namespace mylib
 
 #endif // MYLIB_COROUTINE_TASK_H
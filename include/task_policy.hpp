@@ -0,0 +1,90 @@
+#ifndef MYLIB_TASK_POLICY_H
+#define MYLIB_TASK_POLICY_H 1
+
+#include <concepts>
+#include <type_traits>
+
+#include "cancellation.hpp"
+#include "symmetric_task_storage.hpp"
+
+namespace mylib {
+
+    // Compile-time switches of what a task promise has to carry.
+    // exceptions: result storage can hold an exception, otherwise a bare value slot and
+    //             an escaping exception terminates.
+    // cancellation: the task can complete stopped and inherits a stop token,
+    //               otherwise only a continuation is kept.
+    // joinable (optional, true unless given): the task can be a child of when_all or when_any,
+    //           otherwise the promise has no slot for the combinator and can only be awaited.
+    template<typename Policy>
+    concept task_policy = requires {
+        { Policy::exceptions } -> std::convertible_to<bool>;
+        { Policy::cancellation } -> std::convertible_to<bool>;
+    };
+
+    struct default_task_policy
+    {
+        constexpr static bool exceptions = true;
+        constexpr static bool cancellation = true;
+    };
+
+    struct nothrow_policy
+    {
+        constexpr static bool exceptions = false;
+        constexpr static bool cancellation = true;
+    };
+
+    struct no_cancel_policy
+    {
+        constexpr static bool exceptions = true;
+        constexpr static bool cancellation = false;
+    };
+
+    // For leaf tasks on hot paths, which neither throw nor cancel, and are only ever awaited
+    struct leaf_policy
+    {
+        constexpr static bool exceptions = false;
+        constexpr static bool cancellation = false;
+        constexpr static bool joinable = false;
+    };
+
+    // For frames with no try around their co_await: an exception of an awaited task is taken over
+    // unchanged and completes this frame at once, without being rethrown here.
+    // Only the first frame up the chain not using this policy rethrows it.
+    struct forward_exceptions_policy
+    {
+        constexpr static bool exceptions = true;
+        constexpr static bool cancellation = true;
+        constexpr static bool forward_exceptions = true;
+    };
+
+    namespace details {
+
+        // Optional policy flag, false unless given
+        template<typename Policy>
+        constexpr bool policy_forwards_exceptions = false;
+
+        template<typename Policy>
+            requires requires { { Policy::forward_exceptions } -> std::convertible_to<bool>; }
+        constexpr bool policy_forwards_exceptions<Policy> = Policy::forward_exceptions;
+
+        template<typename Policy>
+        constexpr bool policy_joinable = true;
+
+        template<typename Policy>
+            requires requires { { Policy::joinable } -> std::convertible_to<bool>; }
+        constexpr bool policy_joinable<Policy> = Policy::joinable;
+
+        template<typename ReturnType, task_policy Policy>
+        using policy_storage_t = std::conditional_t<Policy::exceptions,
+            mylib::symmetric_task_storage<ReturnType>, mylib::nothrow_task_storage<ReturnType>>;
+
+        template<task_policy Policy>
+        using policy_continuation_t = std::conditional_t<Policy::cancellation,
+            mylib::cancellation_base, mylib::continuation_base>;
+
+    } // namespace mylib::details
+
+} // namespace mylib
+
+#endif // MYLIB_TASK_POLICY_H
@@ -0,0 +1,241 @@
+#ifndef MYLIB_THREAD_POOL_H
+#define MYLIB_THREAD_POOL_H 1
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+
+#include "detached_task.hpp"
+#include "executor.hpp"
+#include "work_stealing_deque.hpp"
+
+namespace mylib {
+
+    // Work-stealing thread pool.
+    // Every worker owns a Chase-Lev deque: coroutines scheduled from a worker go to its own deque,
+    // idle workers steal from the others. Coroutines scheduled from outside the pool go to
+    // a worker's inbox, picked round robin. There is no queue shared by all workers.
+    // Continuations keep running on whichever worker resumed them, so symmetric transfer
+    // between tasks stays on one thread. Work still queued at destruction is run before joining.
+    // Detached tasks failing on a worker go to the pool's detached_error_sink instead of throwing
+    // out of the worker loop; workers reap them between resumes and pass the exceptions to on_error.
+    class thread_pool
+    {
+    public:
+        using error_handler = void(*)(std::exception_ptr) noexcept;
+
+        // As if the exception had escaped the worker thread
+        static void terminate_on_error(std::exception_ptr) noexcept { std::terminate(); }
+
+        explicit thread_pool(std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+            error_handler on_error = &terminate_on_error)
+            : on_error(on_error)
+        {
+            this->workers.reserve(thread_count);
+            for (std::size_t i = 0; i < thread_count; ++i) {
+                this->workers.push_back(std::make_unique<worker>(this, i));
+            }
+            for (auto& w : this->workers) {
+                w->thread = std::thread([w = w.get()] { w->run(); });
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        ~thread_pool() {
+            this->stopping.store(true, std::memory_order_seq_cst);
+            this->epoch.fetch_add(1, std::memory_order_seq_cst);
+            this->epoch.notify_all();
+            for (auto& w : this->workers) {
+                w->thread.join();
+            }
+            this->errors.reap(this->on_error);
+        }
+
+        std::size_t size() const noexcept { return this->workers.size(); }
+
+        // True if the calling thread is one of this pool's workers
+        bool on_pool_thread() const noexcept {
+            return current_worker != nullptr && current_worker->pool == this;
+        }
+
+        // Pool the calling thread works for, null off any pool
+        static thread_pool* current() noexcept {
+            return current_worker ? current_worker->pool : nullptr;
+        }
+
+        struct [[nodiscard]] schedule_awaiter
+        {
+            constexpr bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { this->pool->enqueue(h); }
+            constexpr void await_resume() const noexcept {}
+
+            thread_pool* pool;
+        };
+
+        // co_await pool.schedule() continues the current coroutine on a worker
+        schedule_awaiter schedule() noexcept { return { this }; }
+
+        // Start a detached task on a worker
+        void spawn(detached_task task) {
+            this->enqueue(std::move(task).to_handle());
+        }
+
+        void enqueue(std::coroutine_handle<> h) {
+            if (this->on_pool_thread()) {
+                current_worker->local.push(h);
+            } else {
+                const std::size_t i = this->next_inbox.fetch_add(1, std::memory_order_relaxed) % this->workers.size();
+                this->workers[i]->post(h);
+            }
+            this->wake_one();
+        }
+
+        // Pop the coroutine last enqueued by the calling worker, unless stolen since.
+        // Only from a worker of this pool.
+        std::coroutine_handle<> take_local() noexcept {
+            assert(this->on_pool_thread() && "take_local called off the pool!");
+            return current_worker->local.take();
+        }
+
+    private:
+        struct worker
+        {
+            worker(thread_pool* pool, std::size_t index) : pool(pool), index(index) {}
+
+            void post(std::coroutine_handle<> h) {
+                std::scoped_lock lock(this->inbox_mutex);
+                this->inbox.push_back(h);
+            }
+
+            // Move externally posted work onto the deque, making it stealable
+            bool drain_inbox(bool wait) {
+                std::unique_lock lock(this->inbox_mutex, std::defer_lock);
+                if (wait) {
+                    lock.lock();
+                } else if (!lock.try_lock()) {
+                    return false;
+                }
+                if (this->inbox.empty()) {
+                    return false;
+                }
+                this->stash.swap(this->inbox);
+                lock.unlock();
+                for (std::coroutine_handle<> h : this->stash) {
+                    this->local.push(h);
+                }
+                this->stash.clear();
+                return true;
+            }
+
+            std::coroutine_handle<> steal_from(worker& victim) {
+                if (std::coroutine_handle<> h = victim.local.steal()) {
+                    return h;
+                }
+                std::unique_lock lock(victim.inbox_mutex, std::try_to_lock);
+                if (lock && !victim.inbox.empty()) {
+                    std::coroutine_handle<> h = victim.inbox.back();
+                    victim.inbox.pop_back();
+                    return h;
+                }
+                return nullptr;
+            }
+
+            std::coroutine_handle<> find_work() {
+                if (std::coroutine_handle<> h = this->local.take()) {
+                    return h;
+                }
+                if (this->drain_inbox(true)) {
+                    if (std::coroutine_handle<> h = this->local.take()) {
+                        return h;
+                    }
+                }
+                const std::size_t n = this->pool->workers.size();
+                for (std::size_t k = 1; k < n; ++k) {
+                    if (std::coroutine_handle<> h = this->steal_from(*this->pool->workers[(this->index + k) % n])) {
+                        return h;
+                    }
+                }
+                return nullptr;
+            }
+
+            void run() {
+                current_worker = this;
+                thread_pool& p = *this->pool;
+                detached_error_sink::scoped_install sink(p.errors);
+                for (;;) {
+                    const std::uint64_t e = p.epoch.load(std::memory_order_seq_cst);
+                    if (std::coroutine_handle<> h = this->find_work()) {
+                        h.resume();
+                        p.reap_errors();
+                        continue;
+                    }
+                    if (p.stopping.load(std::memory_order_seq_cst)) {
+                        break;
+                    }
+                    p.sleeping.fetch_add(1, std::memory_order_seq_cst);
+                    // Re-check after announcing, pairs with the fence in wake_one
+                    if (std::coroutine_handle<> h = this->find_work()) {
+                        p.sleeping.fetch_sub(1, std::memory_order_relaxed);
+                        h.resume();
+                        p.reap_errors();
+                        continue;
+                    }
+                    p.epoch.wait(e, std::memory_order_seq_cst);
+                    p.sleeping.fetch_sub(1, std::memory_order_relaxed);
+                }
+                current_worker = nullptr;
+            }
+
+            thread_pool* pool;
+            std::size_t index;
+            work_stealing_deque local;
+            std::mutex inbox_mutex;
+            std::vector<std::coroutine_handle<>> inbox;
+            std::vector<std::coroutine_handle<>> stash;
+            std::thread thread;
+        };
+
+        // Whichever worker sees failed frames first reaps the whole batch
+        void reap_errors() noexcept {
+            if (this->errors.empty() || this->reaping.test_and_set(std::memory_order_acquire)) {
+                return;
+            }
+            this->errors.reap(this->on_error);
+            this->reaping.clear(std::memory_order_release);
+        }
+
+        void wake_one() noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (this->sleeping.load(std::memory_order_seq_cst) > 0) {
+                this->epoch.fetch_add(1, std::memory_order_seq_cst);
+                this->epoch.notify_one();
+            }
+        }
+
+        static inline thread_local constinit worker* current_worker = nullptr;
+
+        error_handler on_error;
+        detached_error_sink errors;
+        std::atomic_flag reaping;
+        std::vector<std::unique_ptr<worker>> workers;
+        std::atomic<std::size_t> next_inbox = 0;
+        std::atomic<bool> stopping = false;
+        alignas(64) std::atomic<std::uint64_t> epoch = 0;
+        alignas(64) std::atomic<std::size_t> sleeping = 0;
+    };
+
+} // namespace mylib
+
+#endif // MYLIB_THREAD_POOL_H
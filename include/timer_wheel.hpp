@@ -0,0 +1,334 @@
+#ifndef MYLIB_TIMER_WHEEL_H
+#define MYLIB_TIMER_WHEEL_H 1
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+#include <cassert>
+
+#include "cancellation.hpp"
+#include "stop_token.hpp"
+
+namespace mylib {
+
+    class timer_wheel;
+
+    // Intrusive node of a timer_wheel slot list. Lives in whatever waits on it,
+    // so arming and disarming a timer never allocates.
+    class timer_entry
+    {
+    public:
+        using callback_type = void(*)(timer_entry&);
+
+        timer_entry() noexcept = default;
+        explicit timer_entry(callback_type callback) noexcept : callback(callback) {}
+
+        timer_entry(const timer_entry&) = delete;
+        timer_entry& operator=(const timer_entry&) = delete;
+
+        inline ~timer_entry();
+
+        bool armed() const noexcept { return this->wheel != nullptr; }
+
+    private:
+        friend timer_wheel;
+
+        void unlink() noexcept {
+            this->prev->next = this->next;
+            this->next->prev = this->prev;
+            this->prev = this->next = this;
+        }
+
+        timer_entry* prev = this;
+        timer_entry* next = this;
+        timer_wheel* wheel = nullptr;
+        std::uint64_t expiry = 0;
+        callback_type callback = nullptr;
+    };
+
+    // Hierarchical timing wheel with O(1) insert and cancel.
+    // Six levels of 64 slots; level 0 has tick resolution, each level above is 64 times coarser,
+    // and entries cascade down as their level comes due. Entries may be armed and cancelled from
+    // any thread under a short lock; advance is called by the one thread driving the wheel.
+    class timer_wheel
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+        using duration = clock::duration;
+        using time_point = clock::time_point;
+
+        constexpr static unsigned slot_bits = 6;
+        constexpr static std::size_t slot_count = std::size_t{ 1 } << slot_bits;
+        constexpr static std::size_t level_count = 6;
+
+        explicit timer_wheel(duration tick = std::chrono::milliseconds(1), time_point start = clock::now()) noexcept
+            : tick(tick), start(start)
+        {}
+
+        timer_wheel(const timer_wheel&) = delete;
+        timer_wheel& operator=(const timer_wheel&) = delete;
+
+        // Every timer must have fired or been cancelled by then: nothing would ever resume
+        // a sleeper still pending. Release builds detach what is left, so its entries
+        // do not touch the dead wheel.
+        ~timer_wheel() {
+            assert(this->count == 0 && "timer_wheel destroyed with pending timers!");
+            for (auto& level : this->levels) {
+                for (auto& slot : level) {
+                    while (slot.next != &slot) {
+                        timer_entry* e = slot.next;
+                        e->unlink();
+                        e->wheel = nullptr;
+                    }
+                }
+            }
+        }
+
+        std::size_t size() const noexcept {
+            std::scoped_lock lock(this->mutex);
+            return this->count;
+        }
+
+        bool empty() const noexcept { return this->size() == 0; }
+
+        // Arm entry to fire at the first tick not before deadline
+        void arm(timer_entry& entry, time_point deadline) noexcept {
+            std::scoped_lock lock(this->mutex);
+            this->arm_locked(entry, deadline);
+        }
+
+        // Disarm entry without firing it, returns false if it was not armed
+        bool cancel(timer_entry& entry) noexcept {
+            std::scoped_lock lock(this->mutex);
+            return this->cancel_locked(entry);
+        }
+
+        // Fire every entry due at now. Callbacks run one at a time without the lock held
+        // and may arm or cancel other entries; if one throws, the remaining due entries fire on the next call.
+        std::size_t advance(time_point now = clock::now()) {
+            const std::uint64_t target = now < this->start ? 0 : static_cast<std::uint64_t>((now - this->start) / this->tick);
+            std::size_t fired = 0;
+            std::unique_lock lock(this->mutex);
+            for (;;) {
+                timer_entry& slot = this->levels[0][this->current & (slot_count - 1)];
+                while (slot.next != &slot) {
+                    timer_entry* e = slot.next;
+                    e->unlink();
+                    e->wheel = nullptr;
+                    --this->count;
+                    ++fired;
+                    lock.unlock();
+                    e->callback(*e);
+                    lock.lock();
+                }
+                if (this->current >= target) {
+                    return fired;
+                }
+                ++this->current;
+                this->cascade();
+            }
+        }
+
+        // Lower bound of the next deadline, to bound how long a driving loop may block.
+        // Entries armed from other threads meanwhile may be due earlier.
+        std::optional<time_point> next_expiry() const noexcept {
+            std::scoped_lock lock(this->mutex);
+            if (this->count == 0) {
+                return std::nullopt;
+            }
+            for (std::uint64_t t = this->current + 1; t < this->current + slot_count; ++t) {
+                const timer_entry& slot = this->levels[0][t & (slot_count - 1)];
+                if (slot.next != &slot) {
+                    return this->to_time_point(t);
+                }
+            }
+            // Nothing on level 0, the next cascade brings entries down
+            return this->to_time_point((this->current | (slot_count - 1)) + 1);
+        }
+
+        class [[nodiscard]] sleep_awaiter;
+
+        // co_await wheel.sleep_until(tp) / wheel.sleep_for(d)
+        // A pending sleep can be cancelled, completing the sleeper through its stopped path.
+        sleep_awaiter sleep_until(time_point deadline) noexcept;
+        sleep_awaiter sleep_for(duration d) noexcept;
+
+    private:
+        void arm_locked(timer_entry& entry, time_point deadline) noexcept {
+            this->cancel_locked(entry);
+            entry.expiry = std::max(this->to_tick(deadline), this->current + 1);
+            entry.wheel = this;
+            this->place(entry);
+            ++this->count;
+        }
+
+        bool cancel_locked(timer_entry& entry) noexcept {
+            if (entry.wheel != this) {
+                return false;
+            }
+            entry.unlink();
+            entry.wheel = nullptr;
+            --this->count;
+            return true;
+        }
+
+        std::uint64_t to_tick(time_point tp) const noexcept {
+            if (tp <= this->start) {
+                return 0;
+            }
+            // Round up, never fire early
+            return static_cast<std::uint64_t>((tp - this->start + this->tick - duration(1)) / this->tick);
+        }
+
+        time_point to_time_point(std::uint64_t t) const noexcept {
+            return this->start + this->tick * static_cast<duration::rep>(t);
+        }
+
+        void place(timer_entry& entry) noexcept {
+            constexpr std::uint64_t max_delta = std::uint64_t{ 1 } << (slot_bits * level_count);
+            std::uint64_t delta = entry.expiry - this->current;
+            std::uint64_t expiry = entry.expiry;
+            if (delta >= max_delta) {
+                // Beyond the top level, park it as far as possible and re-place on cascade
+                delta = max_delta - 1;
+                expiry = this->current + delta;
+            }
+            std::size_t level = 0;
+            while (delta >= (std::uint64_t{ 1 } << (slot_bits * (level + 1)))) {
+                ++level;
+            }
+            timer_entry& slot = this->levels[level][(expiry >> (slot_bits * level)) & (slot_count - 1)];
+            entry.prev = slot.prev;
+            entry.next = &slot;
+            slot.prev->next = &entry;
+            slot.prev = &entry;
+        }
+
+        // Called when current enters a new tick: move the due higher level slots one level down
+        void cascade() noexcept {
+            for (std::size_t level = 1; level < level_count; ++level) {
+                const unsigned shift = slot_bits * level;
+                if ((this->current & ((std::uint64_t{ 1 } << shift) - 1)) != 0) {
+                    return;
+                }
+                timer_entry& slot = this->levels[level][(this->current >> shift) & (slot_count - 1)];
+                timer_entry pending;
+                if (slot.next != &slot) {
+                    // Splice the slot out first, an entry may land in the same slot again
+                    pending.next = slot.next;
+                    pending.prev = slot.prev;
+                    pending.next->prev = &pending;
+                    pending.prev->next = &pending;
+                    slot.prev = slot.next = &slot;
+                }
+                while (pending.next != &pending) {
+                    timer_entry* e = pending.next;
+                    e->unlink();
+                    this->place(*e);
+                }
+            }
+        }
+
+        mutable std::mutex mutex;
+        duration tick;
+        time_point start;
+        std::uint64_t current = 0;
+        std::size_t count = 0;
+        // Slot heads are sentinel entries of circular lists
+        std::array<std::array<timer_entry, slot_count>, level_count> levels;
+    };
+
+    inline timer_entry::~timer_entry() {
+        if (this->wheel) {
+            this->wheel->cancel(*this);
+        }
+    }
+
+    // Sleeps observe the stop token of the sleeper: a stop request cancels the timer and
+    // completes the sleeper through its stopped path, on the requesting thread.
+    class [[nodiscard]] timer_wheel::sleep_awaiter : private timer_entry
+    {
+    public:
+        bool await_ready() const noexcept {
+            return this->deadline <= clock::now();
+        }
+
+        template<typename PromiseType>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> h) noexcept {
+            this->continuation = h;
+            if constexpr (mylib::has_unhandled_stopped<PromiseType>) {
+                this->stopped_handler = &mylib::forward_stopped_handler<PromiseType>;
+                this->on_stop.emplace(mylib::get_stop_token_of(h.promise()), stop_sleep{ this });
+            } else {
+                this->stopped_handler = &mylib::null_stopped_handler;
+            }
+            {
+                std::scoped_lock lock(this->owner->mutex);
+                if (!this->cancelled) {
+                    // May fire on another thread right away, do not touch this from here on
+                    this->owner->arm_locked(*this, this->deadline);
+                    return std::noop_coroutine();
+                }
+            }
+            return this->stopped_handler(h.address());
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+        // Remove the pending timer and complete the sleeping coroutine through unhandled_stopped.
+        // Returns false if the sleep is not pending; a sleep cancelled before it suspends completes stopped.
+        bool cancel() noexcept {
+            {
+                std::scoped_lock lock(this->owner->mutex);
+                if (!this->owner->cancel_locked(*this)) {
+                    this->cancelled = true;
+                    return false;
+                }
+            }
+            this->stopped_handler(this->continuation.address()).resume();
+            return true;
+        }
+
+    private:
+        friend timer_wheel;
+
+        struct stop_sleep
+        {
+            void operator()() noexcept { this->awaiter->cancel(); }
+
+            sleep_awaiter* awaiter;
+        };
+
+        sleep_awaiter(timer_wheel& owner, time_point deadline) noexcept
+            : timer_entry(&fire), owner(&owner), deadline(deadline)
+        {}
+
+        static void fire(timer_entry& e) {
+            static_cast<sleep_awaiter&>(e).continuation.resume();
+        }
+
+        timer_wheel* owner;
+        time_point deadline;
+        bool cancelled = false;
+        std::coroutine_handle<> continuation = nullptr;
+        mylib::stopped_handler_type stopped_handler = &mylib::null_stopped_handler;
+        std::optional<mylib::inplace_stop_callback<stop_sleep>> on_stop;
+    };
+
+    inline timer_wheel::sleep_awaiter timer_wheel::sleep_until(time_point deadline) noexcept {
+        return sleep_awaiter(*this, deadline);
+    }
+
+    inline timer_wheel::sleep_awaiter timer_wheel::sleep_for(duration d) noexcept {
+        return sleep_awaiter(*this, clock::now() + d);
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_TIMER_WHEEL_H
@@ -2,14 +2,30 @@
 #ifndef MYLIB_TRANSACTION_H
 #define MYLIB_TRANSACTION_H 1
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <tuple>
 #include <utility>
 #include <concepts>
 #include <type_traits>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <variant>
 
-#include "task.hpp"
+#include <cassert>
+
+#include "symmetric_task_storage.hpp"
 #include "cancellation.hpp"
+#include "detached_task.hpp"
+#include "stop_token.hpp"
+#include "frame_allocator.hpp"
+#include "awaitable_traits.hpp"
+#include "transaction_metrics.hpp"
 
 namespace mylib {
 
@@ -111,6 +127,134 @@ namespace mylib {
         template<has_rollback Arg>
         using rollback_type = rollback_traits<Arg>::type;
 
+        template<typename Arg>
+        concept member_savepoint = requires (Arg&& arg) { std::forward<Arg>(arg).transaction_savepoint(); };
+
+        template<typename Arg>
+        concept adl_savepoint = requires (Arg&& arg) { transaction_savepoint(std::forward<Arg>(arg)); };
+
+        template<typename Arg>
+        concept has_savepoint = member_savepoint<Arg> || adl_savepoint<Arg>;
+
+        template<typename Arg>
+        concept nothrow_savepoint =
+            member_savepoint<Arg>
+                && requires (Arg&& arg) { { std::forward<Arg>(arg).transaction_savepoint() } noexcept; }
+            || adl_savepoint<Arg>
+                && requires (Arg&& arg) { { transaction_savepoint(std::forward<Arg>(arg)) } noexcept; };
+
+        template<typename Arg>
+        struct savepoint_traits {};
+
+        template<member_savepoint Arg>
+        struct savepoint_traits<Arg> {
+            using type = decltype(std::declval<Arg>().transaction_savepoint());
+        };
+
+        template<adl_savepoint Arg>
+        struct savepoint_traits<Arg> {
+            using type = decltype(transaction_savepoint(std::declval<Arg>()));
+        };
+
+        template<has_savepoint Arg>
+        using savepoint_type = savepoint_traits<Arg>::type;
+
+        template<typename Arg>
+        concept member_release = requires (Arg&& arg) { std::forward<Arg>(arg).transaction_release(); };
+
+        template<typename Arg>
+        concept adl_release = requires (Arg&& arg) { transaction_release(std::forward<Arg>(arg)); };
+
+        template<typename Arg>
+        concept has_release = member_release<Arg> || adl_release<Arg>;
+
+        template<typename Arg>
+        concept nothrow_release =
+            member_release<Arg>
+                && requires (Arg&& arg) { { std::forward<Arg>(arg).transaction_release() } noexcept; }
+            || adl_release<Arg>
+                && requires (Arg&& arg) { { transaction_release(std::forward<Arg>(arg)) } noexcept; };
+
+        template<typename Arg>
+        struct release_traits {};
+
+        template<member_release Arg>
+        struct release_traits<Arg> {
+            using type = decltype(std::declval<Arg>().transaction_release());
+        };
+
+        template<adl_release Arg>
+        struct release_traits<Arg> {
+            using type = decltype(transaction_release(std::declval<Arg>()));
+        };
+
+        template<has_release Arg>
+        using release_type = release_traits<Arg>::type;
+
+        template<typename Arg>
+        concept member_rollback_to = requires (Arg&& arg) { std::forward<Arg>(arg).transaction_rollback_to(); };
+
+        template<typename Arg>
+        concept adl_rollback_to = requires (Arg&& arg) { transaction_rollback_to(std::forward<Arg>(arg)); };
+
+        template<typename Arg>
+        concept has_rollback_to = member_rollback_to<Arg> || adl_rollback_to<Arg>;
+
+        template<typename Arg>
+        concept nothrow_rollback_to =
+            member_rollback_to<Arg>
+                && requires (Arg&& arg) { { std::forward<Arg>(arg).transaction_rollback_to() } noexcept; }
+            || adl_rollback_to<Arg>
+                && requires (Arg&& arg) { { transaction_rollback_to(std::forward<Arg>(arg)) } noexcept; };
+
+        template<typename Arg>
+        struct rollback_to_traits {};
+
+        template<member_rollback_to Arg>
+        struct rollback_to_traits<Arg> {
+            using type = decltype(std::declval<Arg>().transaction_rollback_to());
+        };
+
+        template<adl_rollback_to Arg>
+        struct rollback_to_traits<Arg> {
+            using type = decltype(transaction_rollback_to(std::declval<Arg>()));
+        };
+
+        template<has_rollback_to Arg>
+        using rollback_to_type = rollback_to_traits<Arg>::type;
+
+        template<typename Arg>
+        concept member_prepare = requires (Arg&& arg) { std::forward<Arg>(arg).transaction_prepare(); };
+
+        template<typename Arg>
+        concept adl_prepare = requires (Arg&& arg) { transaction_prepare(std::forward<Arg>(arg)); };
+
+        template<typename Arg>
+        concept has_prepare = member_prepare<Arg> || adl_prepare<Arg>;
+
+        template<typename Arg>
+        concept nothrow_prepare =
+            member_prepare<Arg>
+                && requires (Arg&& arg) { { std::forward<Arg>(arg).transaction_prepare() } noexcept; }
+            || adl_prepare<Arg>
+                && requires (Arg&& arg) { { transaction_prepare(std::forward<Arg>(arg)) } noexcept; };
+
+        template<typename Arg>
+        struct prepare_traits {};
+
+        template<member_prepare Arg>
+        struct prepare_traits<Arg> {
+            using type = decltype(std::declval<Arg>().transaction_prepare());
+        };
+
+        template<adl_prepare Arg>
+        struct prepare_traits<Arg> {
+            using type = decltype(transaction_prepare(std::declval<Arg>()));
+        };
+
+        template<has_prepare Arg>
+        using prepare_type = prepare_traits<Arg>::type;
+
         template<typename>
         inline constexpr bool always_false = false;
 
@@ -153,109 +297,127 @@ namespace mylib {
             }
         };
 
+        struct transaction_savepoint_cpo {
+            template<details::has_savepoint Arg>
+            details::savepoint_type<Arg> operator() (Arg&& arg) const noexcept(details::nothrow_savepoint<Arg>) {
+                if constexpr (requires { std::forward<Arg>(arg).transaction_savepoint(); }) {
+                    return std::forward<Arg>(arg).transaction_savepoint();
+                } else if constexpr (requires { transaction_savepoint(std::forward<Arg>(arg)); }) {
+                    return transaction_savepoint(std::forward<Arg>(arg));
+                } else {
+                    static_assert(details::always_false<Arg>, "transaction_savepoint not found");
+                }
+            }
+        };
+
+        struct transaction_release_cpo {
+            template<details::has_release Arg>
+            details::release_type<Arg> operator() (Arg&& arg) const noexcept(details::nothrow_release<Arg>) {
+                if constexpr (requires { std::forward<Arg>(arg).transaction_release(); }) {
+                    return std::forward<Arg>(arg).transaction_release();
+                } else if constexpr (requires { transaction_release(std::forward<Arg>(arg)); }) {
+                    return transaction_release(std::forward<Arg>(arg));
+                } else {
+                    static_assert(details::always_false<Arg>, "transaction_release not found");
+                }
+            }
+        };
+
+        struct transaction_rollback_to_cpo {
+            template<details::has_rollback_to Arg>
+            details::rollback_to_type<Arg> operator() (Arg&& arg) const noexcept(details::nothrow_rollback_to<Arg>) {
+                if constexpr (requires { std::forward<Arg>(arg).transaction_rollback_to(); }) {
+                    return std::forward<Arg>(arg).transaction_rollback_to();
+                } else if constexpr (requires { transaction_rollback_to(std::forward<Arg>(arg)); }) {
+                    return transaction_rollback_to(std::forward<Arg>(arg));
+                } else {
+                    static_assert(details::always_false<Arg>, "transaction_rollback_to not found");
+                }
+            }
+        };
+
+        struct transaction_prepare_cpo {
+            template<details::has_prepare Arg>
+            details::prepare_type<Arg> operator() (Arg&& arg) const noexcept(details::nothrow_prepare<Arg>) {
+                if constexpr (requires { std::forward<Arg>(arg).transaction_prepare(); }) {
+                    return std::forward<Arg>(arg).transaction_prepare();
+                } else if constexpr (requires { transaction_prepare(std::forward<Arg>(arg)); }) {
+                    return transaction_prepare(std::forward<Arg>(arg));
+                } else {
+                    static_assert(details::always_false<Arg>, "transaction_prepare not found");
+                }
+            }
+        };
+
     } // namespace mylib::details
 
     inline constexpr details::transaction_begin_cpo transaction_begin{};
     inline constexpr details::transaction_commit_cpo transaction_commit{};
     inline constexpr details::transaction_rollback_cpo transaction_rollback{};
 
+    // Optional, for transactions nested in a transaction on the same resource.
+    // Each applies to the most recent savepoint not yet released or rolled back to.
+    inline constexpr details::transaction_savepoint_cpo transaction_savepoint{};
+    inline constexpr details::transaction_release_cpo transaction_release{};
+    inline constexpr details::transaction_rollback_to_cpo transaction_rollback_to{};
+
+    // Optional first phase of two-phase commit, for transactions over several resources.
+    // A resource without it commits in one phase.
+    inline constexpr details::transaction_prepare_cpo transaction_prepare{};
+
     template<typename Arg>
     concept transactional = details::has_begin<Arg> && details::has_commit<Arg> && details::has_rollback<Arg>;
 
+    template<typename Arg>
+    concept savepoint_transactional = transactional<Arg>
+        && details::has_savepoint<Arg> && details::has_release<Arg> && details::has_rollback_to<Arg>;
+
     // Forward declaration
     template<typename ReturnType>
     class transaction;
 
     namespace details {
 
-        template<typename Awaitable>
-        concept member_co_await = requires (Awaitable&& a) { std::forward<Awaitable>(a).operator co_await(); };
-
-        template<typename Awaitable>
-        concept adl_co_await = requires (Awaitable&& a) { operator co_await(std::forward<Awaitable>(a)); };
-
-        template<typename Awaitable>
-        struct awaiter_traits {
-            using type = Awaitable;
-        };
+        // Forward declaration
+        template<typename ReturnType>
+        struct transaction_promise_base;
 
-        template<member_co_await Awaitable>
-        struct awaiter_traits<Awaitable> {
-            using type = decltype(std::declval<Awaitable>().operator co_await());
-        };
+        // Static function table of one transaction_promise, in place of virtual functions
+        template<typename ReturnType>
+        struct transaction_vtable
+        {
+            using promise_base = transaction_promise_base<ReturnType>;
 
-        template<adl_co_await Awaitable>
-        struct awaiter_traits<Awaitable> {
-            using type = decltype(operator co_await(std::declval<Awaitable>()));
+            std::coroutine_handle<> (*start)(promise_base&) noexcept;
+            ReturnType (*do_resume)(promise_base&);
+            void (*destroy)(promise_base&) noexcept;
         };
 
-        template<typename Awaitable>
-        using awaiter_type = awaiter_traits<Awaitable>::type;
-
-        template<typename Awaitable>
-        concept nothrow_co_await = [] {
-            if constexpr (member_co_await<Awaitable>) {
-                return requires (Awaitable&& a) { { std::forward<Awaitable>(a).operator co_await() } noexcept; };
-            } else if constexpr (adl_co_await<Awaitable>) {
-                return requires (Awaitable&& a) { { operator co_await(std::forward<Awaitable>(a)) } noexcept; };
-            } else {
-                return true;
-            }
-        }();
-
-        template<typename Awaitable>
-        awaiter_type<Awaitable> get_awaiter(Awaitable&& a) noexcept(nothrow_co_await<Awaitable>) {
-            if constexpr (requires { std::forward<Awaitable>(a).operator co_await(); }) {
-                return std::forward<Awaitable>(a).operator co_await();
-            } else if constexpr (requires { operator co_await(std::forward<Awaitable>(a)); }) {
-                return operator co_await(std::forward<Awaitable>(a));
-            } else {
-                return std::forward<Awaitable>(a);
-            }
-        }
-
-        template<typename Awaitable>
-        using await_result_t = decltype(std::declval<awaiter_type<Awaitable>>().await_resume());
-
-        template<typename Arg>
-        inline mylib::task<await_result_t<begin_type<Arg>>> begin_task(Arg& arg) {
-            co_return co_await mylib::transaction_begin(arg);
-        }
-
-        template<typename Arg>
-        inline mylib::task<void> commit_task(Arg& arg) {
-            co_await mylib::transaction_commit(arg);
-        }
-
-        template<typename Arg>
-        inline mylib::task<void> rollback_task(Arg& arg) {
-            co_await mylib::transaction_rollback(arg);
-        }
-
-        inline mylib::task<void> noop_task() {
-            co_return;
-        }
-
-        template<typename Arg>
-        inline mylib::cancellation_task cancellation_task(Arg& arg) {
-            co_await rollback_task(arg);
-        }
-
         template<typename ReturnType>
         struct transaction_promise_base
         {
             using return_type = ReturnType;
-            virtual std::coroutine_handle<> from_promise() noexcept = 0;
-            virtual std::coroutine_handle<> transaction_suspend(std::coroutine_handle<>) noexcept = 0;
-            virtual return_type do_resume() = 0;
 
+            // Inherited from the caller, passed on to what the transaction awaits
+            mylib::inplace_stop_token get_stop_token() const noexcept { return this->stop_token; }
+
+            const transaction_vtable<return_type>* vtable;
+            std::coroutine_handle<> continuation = std::noop_coroutine();
             mylib::stopped_handler_type caller_stopped_handler = &mylib::null_stopped_handler;
+            mylib::inplace_stop_token stop_token;
+            // Resource of the transaction awaiting this one, if any
+            const void* parent_resource = nullptr;
+        };
+
+        template<typename PromiseType>
+        concept transaction_parent = requires (const PromiseType& p) {
+            { p.transaction_resource() } noexcept -> std::same_as<const void*>;
         };
 
         template<typename ReturnType>
         struct promise_deleter {
             static void operator() (transaction_promise_base<ReturnType>* p) noexcept {
-                p->from_promise().destroy();
+                p->vtable->destroy(*p);
             }
         };
 
@@ -266,6 +428,10 @@ namespace mylib {
         template<typename ReturnType, typename Arg>
         struct transaction_promise;
 
+        // Forward declaration
+        template<typename ReturnType, typename... Args>
+        struct multi_transaction_promise;
+
         template<typename ReturnType>
         class [[nodiscard]] transaction_awaiter
         {
@@ -289,16 +455,28 @@ namespace mylib {
 
             template<typename OtherPromise>
             std::coroutine_handle<> await_suspend(std::coroutine_handle<OtherPromise> current) noexcept {
+                return this->start_with(current, mylib::get_stop_token_of(current.promise()));
+            }
+
+            // Start with token in place of the one inherited from current,
+            // for wrappers bringing a stop source of their own
+            template<typename OtherPromise>
+            std::coroutine_handle<> start_with(std::coroutine_handle<OtherPromise> current, mylib::inplace_stop_token token) noexcept {
                 if constexpr (requires (OtherPromise& p) { p.unhandled_stopped(); }) {
                     this->handle->caller_stopped_handler = &mylib::forward_stopped_handler<OtherPromise>;
                 } else {
                     this->handle->caller_stopped_handler = &mylib::null_stopped_handler;
                 }
-                return this->handle->transaction_suspend(current);
+                this->handle->stop_token = token;
+                this->handle->continuation = current;
+                if constexpr (transaction_parent<OtherPromise>) {
+                    this->handle->parent_resource = current.promise().transaction_resource();
+                }
+                return this->handle->vtable->start(*this->handle);
             }
 
             return_type await_resume() {
-                return this->handle->do_resume();
+                return this->handle->vtable->do_resume(*this->handle);
             }
 
         private:
@@ -342,6 +520,8 @@ namespace mylib {
 
         template<typename, typename>
         friend struct details::transaction_promise;
+        template<typename, typename...>
+        friend struct details::multi_transaction_promise;
 
         explicit transaction(handle_type&& handle) noexcept
             : handle(std::move(handle))
@@ -352,6 +532,8 @@ namespace mylib {
 
     struct get_begin_result_tag {};
 
+    // co_await begin_result() inside a transaction gives what transaction_begin returned.
+    // A nested transaction starts at a savepoint instead and throws std::logic_error.
     consteval get_begin_result_tag begin_result() { return {}; }
 
     struct eager_rollback_tag {};
@@ -401,112 +583,208 @@ namespace mylib {
             }
         };
 
+        // Awaiting slots of the savepoint calls, placeholders if the resource has none
+        template<typename Arg>
+        struct savepoint_awaitings
+        {
+            using savepoint = std::monostate;
+            using release = std::monostate;
+            using rollback_to = std::monostate;
+        };
+
+        template<typename Arg>
+            requires mylib::savepoint_transactional<Arg>
+        struct savepoint_awaitings<Arg>
+        {
+            using savepoint = awaiting<savepoint_type<Arg>>;
+            using release = awaiting<release_type<Arg>>;
+            using rollback_to = awaiting<rollback_to_type<Arg>>;
+        };
+
+        // Frame reserved in a transaction promise for the coroutine resumed once the rollback of
+        // a stopped transaction completes, which then forwards the stop to the caller of the transaction.
+        // Starting it never allocates: a compiler laying out a frame larger than reserved terminates
+        // at the first stop, which the stopped transaction test exercises.
+        template<typename ReturnType>
+        class stopped_relay
+        {
+        public:
+            stopped_relay() noexcept = default;
+
+            stopped_relay(const stopped_relay&) = delete;
+            stopped_relay& operator=(const stopped_relay&) = delete;
+
+            ~stopped_relay() {
+                if (this->handle) {
+                    this->handle.destroy();
+                }
+            }
+
+            std::coroutine_handle<> start(transaction_promise_base<ReturnType>& base) noexcept {
+                assert(!this->handle && "Stopped twice.");
+                this->handle = relay(*this, base).handle;
+                return this->handle;
+            }
+
+        private:
+            constexpr static std::size_t frame_size = 64;
+
+            struct relay_task
+            {
+                struct promise_type
+                {
+                    static void* operator new(std::size_t size, stopped_relay& slot, transaction_promise_base<ReturnType>&) {
+                        if (size > frame_size) {
+                            assert(false && "stopped_relay frame larger than reserved, raise frame_size!");
+                            std::terminate();
+                        }
+                        return slot.storage;
+                    }
+
+                    static void operator delete(void*, std::size_t) noexcept {}
+
+                    promise_type(stopped_relay&, transaction_promise_base<ReturnType>& base) noexcept : base(&base) {}
+
+                    relay_task get_return_object() noexcept {
+                        return { std::coroutine_handle<promise_type>::from_promise(*this) };
+                    }
+
+                    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+                    struct final_awaiter
+                    {
+                        constexpr bool await_ready() const noexcept { return false; }
+
+                        // The caller may destroy the transaction, and this frame with it, from its stopped path
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) const noexcept {
+                            transaction_promise_base<ReturnType>& base = *h.promise().base;
+                            return base.caller_stopped_handler(base.continuation.address());
+                        }
+
+                        constexpr void await_resume() const noexcept {}
+                    };
+
+                    final_awaiter final_suspend() const noexcept { return {}; }
+                    void return_void() const noexcept {}
+                    [[noreturn]] void unhandled_exception() const noexcept { std::terminate(); }
+
+                    transaction_promise_base<ReturnType>* base;
+                };
+
+                std::coroutine_handle<promise_type> handle;
+            };
+
+            static relay_task relay(stopped_relay&, transaction_promise_base<ReturnType>&) { co_return; }
+
+            alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) std::byte storage[frame_size];
+            std::coroutine_handle<> handle = nullptr;
+        };
+
         template<typename ReturnType, typename Arg>
-        struct transaction_promise : transaction_promise_base<ReturnType>, return_base<ReturnType>
+        struct transaction_promise :
+            transaction_promise_base<ReturnType>,
+            return_base<ReturnType>,
+            mylib::details::pooled_frame
         {
             using return_type = ReturnType;
             using transaction_type = transaction<return_type>;
             using promise_type = transaction_promise;
             using handle_type = std::coroutine_handle<promise_type>;
+            using promise_base = transaction_promise_base<return_type>;
 
             friend return_base<return_type>;
 
             template<typename... Rests>
             transaction_promise(Arg& arg, Rests&&...) noexcept
-                : first_arg(arg)
+                : promise_base{ &function_table }, first_arg(arg)
             {}
 
-            std::coroutine_handle<> from_promise() noexcept override {
-                return handle_type::from_promise(*this);
-            }
-
-            std::coroutine_handle<> transaction_suspend(std::coroutine_handle<> h) noexcept override {
-                this->continuation = h;
-                return this->begin_task_handle;
-            }
-
-            return_type do_resume() override { return this->storage.do_resume(); }
+            // Frame allocated from the allocator, see pooled_frame
+            template<typename Alloc, typename... Rests>
+            transaction_promise(std::allocator_arg_t, const Alloc&, Arg& arg, Rests&&...) noexcept
+                : promise_base{ &function_table }, first_arg(arg)
+            {}
 
             transaction_type get_return_object() noexcept {
                 return transaction_type{ transaction_handle_type<return_type>(this) };
             }
 
-            using begin_result_type = await_result_t<begin_type<Arg>>;
-            using begin_task_type = mylib::task<begin_result_type>;
-            using begin_task_awaiter_type = begin_task_type::task_awaiter;
-            using begin_task_handle_type = begin_task_type::handle_type;
+            // Awaitables of the resource, awaited in place from this frame
+            using begin_awaitable = begin_type<Arg&>;
+            using commit_awaitable = commit_type<Arg&>;
+            using rollback_awaitable = rollback_type<Arg&>;
+            using savepoint_slots = savepoint_awaitings<Arg&>;
+
+            // Awaited from a transaction on the same resource, this one nests as a savepoint if it can
+            constexpr static bool savepoints = mylib::savepoint_transactional<Arg&>;
+
+            constexpr static bool metrics = mylib::enable_transaction_metrics<Arg>;
+
+            using begin_result_type = await_result_t<begin_awaitable>;
             using begin_result_storage_type = std::conditional_t<
                 std::is_void_v<begin_result_type>,
                 std::monostate,
                 std::variant<std::monostate, begin_result_type>
             >;
 
+            // Resource of this transaction while its body runs, for transactions awaited from here
+            const void* transaction_resource() const noexcept {
+                return this->status == transaction_status::done ? nullptr : std::addressof(this->first_arg);
+            }
+
+            // Resumed once transaction_begin or transaction_savepoint completes
             struct transaction_initial_awaiter
             {
-                begin_task_awaiter_type awaiter;
                 promise_type* promise;
 
                 constexpr bool await_ready() const noexcept { return false; }
+                constexpr void await_suspend(handle_type) const noexcept {}
 
-                void await_suspend(handle_type current) noexcept {
-                    promise->begin_task_handle = awaiter.await_suspend(current);
-                }
-
-                constexpr void await_resume() noexcept {
-                    if constexpr (!std::is_void_v<begin_result_type>) {
-                        promise->begin_result.template emplace<1>(awaiter.await_resume());
-                    }
-                }
+                void await_resume() { promise->finish_begin(); }
             };
 
-            transaction_initial_awaiter initial_suspend() {
-                return { begin_task(first_arg).operator co_await(), this };
-            }
-
-            using final_task_type = mylib::task<void>;
-            using final_task_awaiter_type = final_task_type::task_awaiter;
+            transaction_initial_awaiter initial_suspend() noexcept { return { this }; }
 
+            // Commit or rollback resumes the caller directly, its result is taken in do_resume
             struct transaction_final_awaiter
             {
-                final_task_awaiter_type awaiter;
                 promise_type* promise;
 
                 constexpr bool await_ready() const noexcept { return false; }
 
-                std::coroutine_handle<> await_suspend(handle_type current) noexcept {
-                    return awaiter.await_suspend(promise->continuation);
+                std::coroutine_handle<> await_suspend(handle_type) noexcept {
+                    switch (promise->status) {
+                        case transaction_status::need_rollback:
+                            promise->status = transaction_status::done;
+                            promise->end_body(mylib::transaction_outcome::exception_rollback);
+                            return promise->rollback_then(promise->continuation);
+                        case transaction_status::need_commit:
+                            promise->status = transaction_status::done;
+                            promise->end_body(mylib::transaction_outcome::commit);
+                            return promise->commit_then(promise->continuation);
+                        case transaction_status::done:
+                            return promise->continuation;
+                        default:
+                            std::unreachable();
+                    }
                 }
 
                 constexpr void await_resume() const noexcept {}
             };
 
-            transaction_final_awaiter final_suspend() noexcept {
-                switch (status) {
-                    case transaction_status::need_rollback:
-                        status = transaction_status::done;
-                        return { rollback_task(first_arg).operator co_await(), this };
-                    case transaction_status::need_commit:
-                        status = transaction_status::done;
-                        return { commit_task(first_arg).operator co_await(), this };
-                    case transaction_status::done:
-                        return { noop_task().operator co_await(), this };
-                    default:
-                        std::unreachable();
-                }
-            }
+            transaction_final_awaiter final_suspend() noexcept { return { this }; }
 
             void unhandled_exception() noexcept { storage.unhandled_exception(); }
 
+            // Roll back first, the stop reaches the caller once the rollback completes
             std::coroutine_handle<> unhandled_stopped() noexcept {
-                std::coroutine_handle<> outer_handler = this->caller_stopped_handler(
-                    this->continuation.address()
-                );
                 switch (status) {
                     case transaction_status::need_rollback:
                         status = transaction_status::done;
-                        return cancellation_task(first_arg).chain_cancel(outer_handler);
+                        this->end_body(mylib::transaction_outcome::cancellation_rollback);
+                        return this->rollback_then(this->relay.start(*this));
                     case transaction_status::done:
-                        return outer_handler;
+                        return this->caller_stopped_handler(this->continuation.address());
                     case transaction_status::need_commit:
                     default:
                         std::unreachable();
@@ -533,11 +811,13 @@ namespace mylib {
             {
                 begin_result_storage_type* begin_result;
 
-                begin_result_type await_resume()
-                    noexcept(std::is_void_v<begin_result_type> || std::is_nothrow_move_constructible_v<begin_result_type>) {
+                begin_result_type await_resume() {
                     if constexpr (std::is_void_v<begin_result_type>) {
                         return;
                     } else {
+                        if (begin_result->index() != 1) {
+                            throw std::logic_error("No begin result, a nested transaction starts at a savepoint.");
+                        }
                         return std::move(*std::get_if<1>(begin_result));
                     }
                 }
@@ -547,39 +827,607 @@ namespace mylib {
                 return begin_result_awaiter{ {}, &this->begin_result };
             }
 
-            struct eager_rollback_awaiter
+            struct [[nodiscard]] eager_rollback_awaiter
             {
-                final_task_awaiter_type awaiter;
-                promise_type* promise;
-
-                bool await_ready() const noexcept {
+                explicit eager_rollback_awaiter(promise_type* promise) {
                     if (promise->status == transaction_status::done) {
-                        return true;
+                        return;
+                    }
+                    promise->status = transaction_status::done;
+                    promise->end_body(mylib::transaction_outcome::eager_rollback);
+                    if constexpr (metrics) {
+                        this->timed = promise;
+                    }
+                    if constexpr (savepoints) {
+                        if (promise->nested) {
+                            this->rollback.template emplace<2>([promise] { return mylib::transaction_rollback_to(promise->first_arg); });
+                            return;
+                        }
                     }
-                    return false;
+                    this->rollback.template emplace<1>([promise] { return mylib::transaction_rollback(promise->first_arg); });
                 }
 
-                std::coroutine_handle<> await_suspend(handle_type current) noexcept {
-                    promise->status = transaction_status::done;
-                    return awaiter.await_suspend(current);
+                bool await_ready() {
+                    return std::visit([](auto& a) {
+                        if constexpr (std::same_as<std::remove_cvref_t<decltype(a)>, std::monostate>) {
+                            return true;
+                        } else {
+                            return a.await_ready();
+                        }
+                    }, this->rollback);
                 }
 
-                constexpr void await_resume() const noexcept {}
+                std::coroutine_handle<> await_suspend(handle_type current) {
+                    return std::visit([current](auto& a) -> std::coroutine_handle<> {
+                        if constexpr (std::same_as<std::remove_cvref_t<decltype(a)>, std::monostate>) {
+                            return current;
+                        } else {
+                            return a.await_suspend(current);
+                        }
+                    }, this->rollback);
+                }
+
+                void await_resume() {
+                    if constexpr (metrics) {
+                        if (this->timed) {
+                            this->timed->timing.lap(mylib::transaction_phase::rollback);
+                        }
+                    }
+                    promise_type::resume_phase(this->rollback);
+                }
+
+                // Promise to time the rollback of, with metrics enabled
+                [[no_unique_address]] std::conditional_t<metrics, promise_type*, std::monostate> timed{};
+                std::variant<std::monostate, awaiting<rollback_awaitable>, typename savepoint_slots::rollback_to> rollback;
             };
 
-            eager_rollback_awaiter await_transform(mylib::eager_rollback_tag) noexcept {
-                return { rollback_task(first_arg).operator co_await(), this };
+            eager_rollback_awaiter await_transform(mylib::eager_rollback_tag) {
+                return eager_rollback_awaiter(this);
             }
 
         private:
+            constexpr static std::size_t full_begin = 1;
+            constexpr static std::size_t savepoint_begin = 2;
+
+            constexpr static std::size_t commit_phase = 1;
+            constexpr static std::size_t rollback_phase = 2;
+            constexpr static std::size_t release_phase = 3;
+            constexpr static std::size_t rollback_to_phase = 4;
+
+            // Emplace the awaitable made by make into alternative I of slot and await it,
+            // next being resumed once it completes
+            template<std::size_t I, typename Slot, typename MakeAwaitable, typename Promise>
+            static std::coroutine_handle<> await_in(Slot& slot, MakeAwaitable&& make, std::coroutine_handle<Promise> next) {
+                auto& a = slot.template emplace<I>(std::forward<MakeAwaitable>(make));
+                return a.await_ready() ? next : a.await_suspend(next);
+            }
+
+            // await_resume of whatever awaiting slot holds, its value dropped
+            template<typename Slot>
+            static void resume_phase(Slot& slot) {
+                std::visit([](auto& a) {
+                    if constexpr (!std::same_as<std::remove_cvref_t<decltype(a)>, std::monostate>) {
+                        static_cast<void>(a.await_resume());
+                    }
+                }, slot);
+            }
+
+            // Start transaction_begin, or transaction_savepoint when nested, with this frame as its continuation.
+            // Whatever it throws is rethrown from initial_suspend, as from a co_await in the body.
+            static std::coroutine_handle<> start(promise_base& base) noexcept {
+                promise_type& p = static_cast<promise_type&>(base);
+                handle_type current = handle_type::from_promise(p);
+                p.timing.start();
+                try {
+                    if constexpr (savepoints) {
+                        if (p.parent_resource == std::addressof(p.first_arg)) {
+                            p.nested = true;
+                            return await_in<savepoint_begin>(p.begin,
+                                [&p] { return mylib::transaction_savepoint(p.first_arg); }, current);
+                        }
+                    }
+                    return await_in<full_begin>(p.begin, [&p] { return mylib::transaction_begin(p.first_arg); }, current);
+                } catch (...) {
+                    p.storage.unhandled_exception();
+                    return current;
+                }
+            }
+
+            void finish_begin() {
+                this->timing.lap(mylib::transaction_phase::begin);
+                if (this->storage.has_exception()) {
+                    this->storage.throw_if_exception();
+                }
+                if constexpr (savepoints) {
+                    if (this->nested) {
+                        resume_phase(this->begin);
+                        return;
+                    }
+                }
+                if constexpr (std::is_void_v<begin_result_type>) {
+                    std::get<full_begin>(this->begin).await_resume();
+                } else {
+                    this->begin_result.template emplace<1>(std::get<full_begin>(this->begin).await_resume());
+                }
+            }
+
+            // Commit, or release the savepoint when nested, then resume next.
+            // What the call throws synchronously is stored and next resumed at once,
+            // so it surfaces from do_resume as an exception of the commit would.
+            std::coroutine_handle<> commit_then(std::coroutine_handle<> next) noexcept {
+                try {
+                    if constexpr (savepoints) {
+                        if (this->nested) {
+                            return await_in<release_phase>(this->phase,
+                                [this] { return mylib::transaction_release(this->first_arg); }, next);
+                        }
+                    }
+                    return await_in<commit_phase>(this->phase, [this] { return mylib::transaction_commit(this->first_arg); }, next);
+                } catch (...) {
+                    return this->phase_failed(next);
+                }
+            }
+
+            // Roll back, only to the savepoint when nested, then resume next. Throws are handled as in commit_then.
+            std::coroutine_handle<> rollback_then(std::coroutine_handle<> next) noexcept {
+                try {
+                    if constexpr (savepoints) {
+                        if (this->nested) {
+                            return await_in<rollback_to_phase>(this->phase,
+                                [this] { return mylib::transaction_rollback_to(this->first_arg); }, next);
+                        }
+                    }
+                    return await_in<rollback_phase>(this->phase, [this] { return mylib::transaction_rollback(this->first_arg); }, next);
+                } catch (...) {
+                    return this->phase_failed(next);
+                }
+            }
+
+            // The slot may hold an awaitable never started, or nothing after a throwing emplace
+            std::coroutine_handle<> phase_failed(std::coroutine_handle<> next) noexcept {
+                this->phase.template emplace<0>();
+                this->storage.unhandled_exception();
+                return next;
+            }
+
+            // Body is over, commit or rollback follows
+            void end_body(mylib::transaction_outcome outcome) noexcept {
+                this->timing.lap(mylib::transaction_phase::body);
+                this->timing.outcome(outcome);
+            }
+
+            // Result of commit or rollback, an exception of it wins over the result of the body
+            static return_type do_resume(promise_base& base) {
+                promise_type& p = static_cast<promise_type&>(base);
+                switch (p.phase.index()) {
+                    case commit_phase:
+                    case release_phase:
+                        p.timing.lap(mylib::transaction_phase::commit);
+                        break;
+                    case rollback_phase:
+                    case rollback_to_phase:
+                        p.timing.lap(mylib::transaction_phase::rollback);
+                        break;
+                    default:
+                        break;
+                }
+                resume_phase(p.phase);
+                return p.storage.do_resume();
+            }
+
+            static void destroy(promise_base& base) noexcept {
+                handle_type::from_promise(static_cast<promise_type&>(base)).destroy();
+            }
+
+            constexpr static transaction_vtable<return_type> function_table{ &start, &do_resume, &destroy };
+
             Arg& first_arg;
-            begin_task_handle_type begin_task_handle = nullptr;
+            std::variant<std::monostate, awaiting<begin_awaitable>, typename savepoint_slots::savepoint> begin;
             begin_result_storage_type begin_result;
-            std::coroutine_handle<> continuation = std::noop_coroutine();
+            std::variant<std::monostate,
+                awaiting<commit_awaitable>, awaiting<rollback_awaitable>,
+                typename savepoint_slots::release, typename savepoint_slots::rollback_to> phase;
             mylib::symmetric_task_storage<return_type> storage;
             transaction_status status = transaction_status::need_rollback;
+            bool nested = false;
+            [[no_unique_address]] std::conditional_t<metrics,
+                transaction_timing<Arg>, no_transaction_timing> timing;
+            stopped_relay<return_type> relay;
+        };
+
+
+        // Countdown of the concurrent resource calls of one phase of a multi-resource transaction.
+        // The last call to arrive runs complete, which gives the coroutine to resume next.
+        struct resource_join
+        {
+            using complete_fn = std::coroutine_handle<>(*)(resource_join& join) noexcept;
+
+            std::coroutine_handle<> arrive() noexcept {
+                if (this->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    return this->complete(*this);
+                }
+                return std::noop_coroutine();
+            }
+
+            // First failure of the phase wins
+            void fail(std::exception_ptr e) noexcept {
+                if (!this->failed.exchange(true, std::memory_order_relaxed)) {
+                    this->failure = std::move(e);
+                }
+            }
+
+            complete_fn complete;
+            bool* succeeded = nullptr;
+            std::atomic<std::size_t> count = 0;
+            std::atomic<bool> failed = false;
+            std::atomic<bool> stopped = false;
+            std::exception_ptr failure;
+            mylib::inplace_stop_token call_stop_token;
+        };
+
+        // Awaits one call on one resource and reports to the join, which outlives it
+        class [[nodiscard]] resource_call
+        {
+        public:
+            struct promise_type : mylib::details::pooled_frame
+            {
+                template<typename... Args>
+                promise_type(resource_join& join, std::size_t index, Args&...) noexcept : join(&join), index(index) {}
+
+                resource_call get_return_object() noexcept {
+                    return resource_call(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() noexcept { return {}; }
+
+                struct final_awaiter
+                {
+                    constexpr bool await_ready() const noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                        resource_join& join = *h.promise().join;
+                        h.destroy();
+                        return join.arrive();
+                    }
+
+                    constexpr void await_resume() const noexcept { std::unreachable(); }
+                };
+
+                final_awaiter final_suspend() noexcept { return {}; }
+
+                void return_void() noexcept { this->join->succeeded[this->index] = true; }
+
+                void unhandled_exception() noexcept { this->join->fail(std::current_exception()); }
+
+                // Not destroyed from inside the stopped path of what it awaits
+                std::coroutine_handle<> unhandled_stopped() noexcept {
+                    this->join->stopped.store(true, std::memory_order_relaxed);
+                    return mylib::details::frame_reaper::reap(std::coroutine_handle<promise_type>::from_promise(*this),
+                        &arrive_at, this->join);
+                }
+
+                mylib::inplace_stop_token get_stop_token() const noexcept { return this->join->call_stop_token; }
+
+                static std::coroutine_handle<> arrive_at(void* join) noexcept {
+                    return static_cast<resource_join*>(join)->arrive();
+                }
+
+                resource_join* join;
+                std::size_t index;
+            };
+
+            resource_call() noexcept = default;
+
+            resource_call(resource_call&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+            resource_call& operator=(resource_call&& other) noexcept {
+                std::swap(this->handle, other.handle);
+                return *this;
+            }
+
+            ~resource_call() { if (this->handle) { this->handle.destroy(); } }
+
+            void start() && { std::exchange(this->handle, nullptr).resume(); }
+
+        private:
+            explicit resource_call(std::coroutine_handle<promise_type> handle) noexcept : handle(handle) {}
+
+            std::coroutine_handle<promise_type> handle = nullptr;
+        };
+
+        template<typename MakeAwaitable>
+        resource_call call_resource(resource_join&, std::size_t, MakeAwaitable make) {
+            co_await make();
+        }
+
+        enum class multi_phase {
+            begin, prepare, commit, rollback, eager_rollback
         };
 
+        // Transaction over several transactional leading arguments.
+        // Begin runs on all resources at once. A completed body is committed in two phases:
+        // prepare on all resources having transaction_prepare, then commit on all; if a prepare fails or stops,
+        // every begun resource rolls back instead. Each phase overlaps the calls to different resources,
+        // each call awaited from a small frame of its own.
+        template<typename ReturnType, typename... Args>
+        struct multi_transaction_promise :
+            transaction_promise_base<ReturnType>,
+            return_base<ReturnType>,
+            resource_join,
+            mylib::details::pooled_frame
+        {
+            using return_type = ReturnType;
+            using transaction_type = transaction<return_type>;
+            using promise_type = multi_transaction_promise;
+            using handle_type = std::coroutine_handle<promise_type>;
+            using promise_base = transaction_promise_base<return_type>;
+
+            constexpr static std::size_t resource_count = sizeof...(Args);
+            using resource_set = std::array<bool, resource_count>;
+
+            friend return_base<return_type>;
+
+            template<typename... Rests>
+            multi_transaction_promise(Args&... args, Rests&&...) noexcept
+                : promise_base{ &function_table }, resource_join{ &phase_done }, resources(args...)
+            {}
+
+            // Frame allocated from the allocator, see pooled_frame
+            template<typename Alloc, typename... Rests>
+            multi_transaction_promise(std::allocator_arg_t, const Alloc&, Args&... args, Rests&&...) noexcept
+                : promise_base{ &function_table }, resource_join{ &phase_done }, resources(args...)
+            {}
+
+            transaction_type get_return_object() noexcept {
+                return transaction_type{ transaction_handle_type<return_type>(this) };
+            }
+
+            // Resumed once every begin completed
+            struct transaction_initial_awaiter
+            {
+                promise_type* promise;
+
+                constexpr bool await_ready() const noexcept { return false; }
+                constexpr void await_suspend(handle_type) const noexcept {}
+
+                void await_resume() {
+                    if (promise->storage.has_exception()) {
+                        promise->storage.throw_if_exception();
+                    }
+                }
+            };
+
+            transaction_initial_awaiter initial_suspend() noexcept { return { this }; }
+
+            // The last call of the last phase resumes the caller
+            struct transaction_final_awaiter
+            {
+                promise_type* promise;
+
+                constexpr bool await_ready() const noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(handle_type) noexcept {
+                    switch (promise->status) {
+                        case transaction_status::need_rollback:
+                            promise->status = transaction_status::done;
+                            return promise->launch(multi_phase::rollback, promise->begun);
+                        case transaction_status::need_commit:
+                            promise->status = transaction_status::done;
+                            return promise->launch(multi_phase::prepare, promise->begun);
+                        case transaction_status::done:
+                            return promise->continuation;
+                        default:
+                            std::unreachable();
+                    }
+                }
+
+                constexpr void await_resume() const noexcept {}
+            };
+
+            transaction_final_awaiter final_suspend() noexcept { return { this }; }
+
+            void unhandled_exception() noexcept { storage.unhandled_exception(); }
+
+            std::coroutine_handle<> unhandled_stopped() noexcept {
+                this->complete_stopped = true;
+                switch (status) {
+                    case transaction_status::need_rollback:
+                        status = transaction_status::done;
+                        return this->launch(multi_phase::rollback, this->begun);
+                    case transaction_status::done:
+                        return this->caller_stopped_handler(this->continuation.address());
+                    case transaction_status::need_commit:
+                    default:
+                        std::unreachable();
+                }
+            }
+
+            ~multi_transaction_promise() {
+                switch (status) {
+                    case transaction_status::need_rollback:
+                        std::terminate();
+                    case transaction_status::done:
+                        return;
+                    case transaction_status::need_commit:
+                    default:
+                        std::unreachable();
+                }
+            }
+
+            // Forwarding overload
+            template<typename T>
+            T&& await_transform(T&& value) noexcept { return std::forward<T>(value); }
+
+            struct [[nodiscard]] eager_rollback_awaiter
+            {
+                promise_type* promise;
+
+                bool await_ready() const noexcept { return promise->status == transaction_status::done; }
+
+                std::coroutine_handle<> await_suspend(handle_type) noexcept {
+                    promise->status = transaction_status::done;
+                    return promise->launch(multi_phase::eager_rollback, promise->begun);
+                }
+
+                void await_resume() {
+                    if (promise->failed.exchange(false, std::memory_order_relaxed)) {
+                        std::rethrow_exception(std::exchange(promise->failure, nullptr));
+                    }
+                }
+            };
+
+            eager_rollback_awaiter await_transform(mylib::eager_rollback_tag) noexcept { return { this }; }
+
+        private:
+            // Start the call of phase p on every resource in which, the last to complete runs phase_done.
+            // Nothing of this frame may be touched once the calls are started but through the join.
+            std::coroutine_handle<> launch(multi_phase p, resource_set which) noexcept {
+                this->phase = p;
+                this->called.fill(false);
+                this->succeeded = this->called.data();
+                this->failed.store(false, std::memory_order_relaxed);
+                this->stopped.store(false, std::memory_order_relaxed);
+                // A rollback must run even once the transaction was asked to stop
+                const bool rolling_back = p == multi_phase::rollback || p == multi_phase::eager_rollback;
+                this->call_stop_token = rolling_back ? mylib::inplace_stop_token() : this->stop_token;
+                this->count.store(std::ranges::count(which, true) + 1, std::memory_order_relaxed);
+                [&]<std::size_t... I>(std::index_sequence<I...>) {
+                    (this->template call<I>(p, which[I]), ...);
+                }(std::index_sequence_for<Args...>{});
+                return this->arrive();
+            }
+
+            template<std::size_t I>
+            void call(multi_phase p, bool active) noexcept {
+                if (!active) {
+                    return;
+                }
+                auto& r = std::get<I>(this->resources);
+                switch (p) {
+                    case multi_phase::begin:
+                        call_resource(*this, I, [&r] { return mylib::transaction_begin(r); }).start();
+                        return;
+                    case multi_phase::prepare:
+                        if constexpr (has_prepare<std::tuple_element_t<I, std::tuple<Args&...>>>) {
+                            call_resource(*this, I, [&r] { return mylib::transaction_prepare(r); }).start();
+                        } else {
+                            // Committed in one phase, nothing to prepare
+                            this->called[I] = true;
+                            static_cast<void>(this->arrive());
+                        }
+                        return;
+                    case multi_phase::commit:
+                        call_resource(*this, I, [&r] { return mylib::transaction_commit(r); }).start();
+                        return;
+                    case multi_phase::rollback:
+                    case multi_phase::eager_rollback:
+                        std::move(this->rollbacks[I]).start();
+                        return;
+                    default:
+                        std::unreachable();
+                }
+            }
+
+            // A failed call replaces a value result, not an exception already there
+            void take_failure() noexcept {
+                if (this->failed.exchange(false, std::memory_order_relaxed)) {
+                    std::exception_ptr e = std::exchange(this->failure, nullptr);
+                    if (!this->storage.has_exception()) {
+                        this->storage.unhandled_exception(std::move(e));
+                    }
+                }
+            }
+
+            static std::coroutine_handle<> phase_done(resource_join& join) noexcept {
+                promise_type& p = static_cast<promise_type&>(join);
+                const bool stopped = p.stopped.load(std::memory_order_relaxed);
+                switch (p.phase) {
+                    case multi_phase::begin:
+                        p.begun = p.called;
+                        p.take_failure();
+                        if (stopped) {
+                            return p.unhandled_stopped();
+                        }
+                        return handle_type::from_promise(p);
+                    case multi_phase::prepare:
+                        if (p.failed.load(std::memory_order_relaxed) || stopped) {
+                            p.take_failure();
+                            p.complete_stopped = stopped;
+                            return p.launch(multi_phase::rollback, p.begun);
+                        }
+                        return p.launch(multi_phase::commit, p.begun);
+                    case multi_phase::commit:
+                    case multi_phase::rollback:
+                        p.take_failure();
+                        if (p.complete_stopped) {
+                            return p.caller_stopped_handler(p.continuation.address());
+                        }
+                        return p.continuation;
+                    case multi_phase::eager_rollback:
+                        return handle_type::from_promise(p);
+                    default:
+                        std::unreachable();
+                }
+            }
+
+            // Start every begin with this frame resumed once all complete.
+            // The rollback calls are made first, so that no stop path allocates; failing that,
+            // the exception is rethrown from initial_suspend with nothing begun.
+            static std::coroutine_handle<> start(promise_base& base) noexcept {
+                promise_type& p = static_cast<promise_type&>(base);
+                try {
+                    [&p]<std::size_t... I>(std::index_sequence<I...>) {
+                        ((p.rollbacks[I] = call_resource(p, I, [&r = std::get<I>(p.resources)] {
+                            return mylib::transaction_rollback(r);
+                        })), ...);
+                    }(std::index_sequence_for<Args...>{});
+                } catch (...) {
+                    p.storage.unhandled_exception();
+                    return handle_type::from_promise(p);
+                }
+                resource_set all;
+                all.fill(true);
+                return p.launch(multi_phase::begin, all);
+            }
+
+            static return_type do_resume(promise_base& base) {
+                return static_cast<promise_type&>(base).storage.do_resume();
+            }
+
+            static void destroy(promise_base& base) noexcept {
+                handle_type::from_promise(static_cast<promise_type&>(base)).destroy();
+            }
+
+            constexpr static transaction_vtable<return_type> function_table{ &start, &do_resume, &destroy };
+
+            std::tuple<Args&...> resources;
+            multi_phase phase = multi_phase::begin;
+            resource_set called{};
+            resource_set begun{};
+            // One per resource, started at most once, unstarted ones freed with the promise
+            std::array<resource_call, resource_count> rollbacks;
+            bool complete_stopped = false;
+            mylib::symmetric_task_storage<return_type> storage;
+            transaction_status status = transaction_status::need_rollback;
+        };
+
+        // multi_transaction_promise over the leading run of transactional arguments
+        template<typename Promise, typename... Rests>
+        struct leading_transactional
+        {
+            using type = Promise;
+        };
+
+        template<typename ReturnType, typename... Done, typename Next, typename... Rests>
+            requires mylib::transactional<Next>
+        struct leading_transactional<multi_transaction_promise<ReturnType, Done...>, Next, Rests...>
+            : leading_transactional<multi_transaction_promise<ReturnType, Done..., std::remove_cvref_t<Next>>, Rests...>
+        {};
+
+        template<typename ReturnType, typename... Args>
+        using multi_transaction_promise_for =
+            typename leading_transactional<multi_transaction_promise<ReturnType>, Args...>::type;
+
     } // namespace mylib::details
 
 } // namespace mylib
@@ -590,4 +1438,22 @@ struct std::coroutine_traits<mylib::transaction<ReturnType>, First, Rests...>
     using promise_type = mylib::details::transaction_promise<ReturnType, std::remove_cvref_t<First>>;
 };
 
+template<typename ReturnType, typename Alloc, mylib::transactional First, typename... Rests>
+struct std::coroutine_traits<mylib::transaction<ReturnType>, std::allocator_arg_t, Alloc, First, Rests...>
+{
+    using promise_type = mylib::details::transaction_promise<ReturnType, std::remove_cvref_t<First>>;
+};
+
+template<typename ReturnType, mylib::transactional First, mylib::transactional Second, typename... Rests>
+struct std::coroutine_traits<mylib::transaction<ReturnType>, First, Second, Rests...>
+{
+    using promise_type = mylib::details::multi_transaction_promise_for<ReturnType, First, Second, Rests...>;
+};
+
+template<typename ReturnType, typename Alloc, mylib::transactional First, mylib::transactional Second, typename... Rests>
+struct std::coroutine_traits<mylib::transaction<ReturnType>, std::allocator_arg_t, Alloc, First, Second, Rests...>
+{
+    using promise_type = mylib::details::multi_transaction_promise_for<ReturnType, First, Second, Rests...>;
+};
+
 #endif // MYLIB_TRANSACTION_H
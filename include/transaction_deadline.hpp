@@ -0,0 +1,135 @@
+#ifndef MYLIB_TRANSACTION_DEADLINE_H
+#define MYLIB_TRANSACTION_DEADLINE_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "cancellation.hpp"
+#include "frame_allocator.hpp"
+#include "stop_token.hpp"
+#include "timer_wheel.hpp"
+#include "transaction.hpp"
+
+namespace mylib {
+
+    namespace details {
+
+        // Timer and stop source of one deadline. Kept apart from the awaiter since the transaction
+        // may complete, and the awaiter go away, while the expiry is still inside request_stop,
+        // either on the wheel thread or below it on this one. Freed by whichever lets go last.
+        class deadline_state : public timer_entry
+        {
+        public:
+            static deadline_state* create() {
+                return ::new (details::frame_pool::allocate(sizeof(deadline_state))) deadline_state();
+            }
+
+            // Held once by the awaiter and once more while armed
+            void acquire() noexcept {
+                this->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void release(int n) noexcept {
+                if (this->refs.fetch_sub(n, std::memory_order_acq_rel) == n) {
+                    this->~deadline_state();
+                    details::frame_pool::deallocate(this, sizeof(deadline_state));
+                }
+            }
+
+            mylib::inplace_stop_source source;
+
+        private:
+            deadline_state() noexcept : timer_entry(&expire) {}
+
+            static void expire(timer_entry& e) {
+                deadline_state& self = static_cast<deadline_state&>(e);
+                self.source.request_stop();
+                self.release(1);
+            }
+
+            std::atomic<int> refs = 1;
+        };
+
+    } // namespace mylib::details
+
+    // Runs a transaction under a stop source of its own, which is stopped when the deadline passes
+    // or when the awaiting coroutine is stopped. What the body is suspended on at that point completes
+    // stopped, so the body is cancelled through the stopped path of the transaction: it is rolled back,
+    // then the awaiting coroutine completes stopped as well. A body not suspended on anything observing
+    // the stop token runs on to its commit.
+    template<typename ReturnType>
+    class [[nodiscard]] deadline_awaiter
+    {
+    public:
+        using return_type = ReturnType;
+        using time_point = timer_wheel::time_point;
+
+        deadline_awaiter(timer_wheel& wheel, time_point deadline, mylib::transaction<return_type>&& txn)
+            : inner(std::move(txn).operator co_await())
+            , wheel(&wheel)
+            , deadline(deadline)
+            , state(details::deadline_state::create())
+        {}
+
+        deadline_awaiter(const deadline_awaiter&) = delete;
+        deadline_awaiter& operator=(const deadline_awaiter&) = delete;
+
+        ~deadline_awaiter() {
+            this->parent_stop.reset();
+            this->state->release(this->wheel->cancel(*this->state) ? 2 : 1);
+        }
+
+        bool await_ready() noexcept { return this->inner.await_ready(); }
+
+        template<typename PromiseType>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> current) noexcept {
+            mylib::inplace_stop_source& source = this->state->source;
+            this->parent_stop.emplace(mylib::get_stop_token_of(current.promise()), forward_stop{ &source });
+            if (this->deadline <= timer_wheel::clock::now()) {
+                source.request_stop();
+            } else {
+                this->state->acquire();
+                this->wheel->arm(*this->state, this->deadline);
+            }
+            return this->inner.start_with(current, source.get_token());
+        }
+
+        return_type await_resume() { return this->inner.await_resume(); }
+
+    private:
+        struct forward_stop
+        {
+            void operator()() noexcept { this->source->request_stop(); }
+
+            mylib::inplace_stop_source* source;
+        };
+
+        details::transaction_awaiter<return_type> inner;
+        timer_wheel* wheel;
+        time_point deadline;
+        details::deadline_state* state;
+        std::optional<mylib::inplace_stop_callback<forward_stop>> parent_stop;
+    };
+
+    // co_await with_deadline(wheel, tp, txn(db)) cancels the transaction if it is still running at tp
+    template<typename ReturnType>
+    deadline_awaiter<ReturnType> with_deadline(timer_wheel& wheel, timer_wheel::time_point deadline,
+        mylib::transaction<ReturnType>&& txn)
+    {
+        return deadline_awaiter<ReturnType>(wheel, deadline, std::move(txn));
+    }
+
+    // co_await with_timeout(wheel, d, txn(db)) cancels the transaction if it runs longer than d
+    template<typename ReturnType>
+    deadline_awaiter<ReturnType> with_timeout(timer_wheel& wheel, timer_wheel::duration timeout,
+        mylib::transaction<ReturnType>&& txn)
+    {
+        return deadline_awaiter<ReturnType>(wheel, timer_wheel::clock::now() + timeout, std::move(txn));
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_TRANSACTION_DEADLINE_H
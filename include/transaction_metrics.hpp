@@ -0,0 +1,259 @@
+#ifndef MYLIB_TRANSACTION_METRICS_H
+#define MYLIB_TRANSACTION_METRICS_H 1
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace mylib {
+
+    // Opt-in per resource type: transactions on a resource of type Resource
+    // record per-phase latencies and outcomes, readable by transaction_metrics<Resource>()
+    template<typename Resource>
+    constexpr bool enable_transaction_metrics = false;
+
+    enum class transaction_phase : std::size_t {
+        begin, body, commit, rollback
+    };
+
+    enum class transaction_outcome : std::size_t {
+        commit, exception_rollback, eager_rollback, cancellation_rollback
+    };
+
+    // Log-linear latency histogram in nanoseconds, HDR style: exact below 32ns,
+    // then 16 buckets per power of two, so any value is off by at most 1/16.
+    // Values from 2^40ns (about 18 minutes) on share the last bucket.
+    class latency_histogram
+    {
+    public:
+        using duration = std::chrono::nanoseconds;
+
+        constexpr static unsigned sub_bits = 4;
+        constexpr static std::uint64_t linear_limit = std::uint64_t{ 2 } << sub_bits;
+        constexpr static unsigned max_bits = 40;
+        constexpr static std::size_t bucket_count = linear_limit + (max_bits - sub_bits - 1) * (std::size_t{ 1 } << sub_bits);
+
+        constexpr static std::size_t bucket_of(std::uint64_t ns) noexcept {
+            ns = std::min(ns, (std::uint64_t{ 1 } << max_bits) - 1);
+            if (ns < linear_limit) {
+                return static_cast<std::size_t>(ns);
+            }
+            const unsigned msb = static_cast<unsigned>(std::bit_width(ns)) - 1;
+            const std::uint64_t sub = (ns >> (msb - sub_bits)) & ((std::uint64_t{ 1 } << sub_bits) - 1);
+            return static_cast<std::size_t>(linear_limit + ((msb - sub_bits - 1) << sub_bits) + sub);
+        }
+
+        // Smallest value falling into bucket b
+        constexpr static std::uint64_t lowest_of(std::size_t b) noexcept {
+            if (b < linear_limit) {
+                return b;
+            }
+            const std::size_t octave = (b - linear_limit) >> sub_bits;
+            const std::uint64_t sub = (b - linear_limit) & ((std::size_t{ 1 } << sub_bits) - 1);
+            return ((std::uint64_t{ 1 } << sub_bits) + sub) << (octave + 1);
+        }
+
+        void record(duration d) noexcept {
+            ++this->buckets[bucket_of(static_cast<std::uint64_t>(std::max(d.count(), duration::rep{ 0 })))];
+        }
+
+        void add(std::size_t bucket, std::uint64_t n) noexcept { this->buckets[bucket] += n; }
+
+        std::uint64_t count() const noexcept {
+            std::uint64_t total = 0;
+            for (std::uint64_t n : this->buckets) {
+                total += n;
+            }
+            return total;
+        }
+
+        // Highest value of the bucket holding the p-th percentile, zero when empty
+        duration percentile(double p) const noexcept {
+            const std::uint64_t total = this->count();
+            if (total == 0) {
+                return duration::zero();
+            }
+            const double rank = std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(total);
+            const std::uint64_t target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(rank + 0.5));
+            std::uint64_t seen = 0;
+            for (std::size_t b = 0; b < bucket_count; ++b) {
+                seen += this->buckets[b];
+                if (seen >= target) {
+                    return highest_of(b);
+                }
+            }
+            return highest_of(bucket_count - 1);
+        }
+
+        duration max() const noexcept {
+            for (std::size_t b = bucket_count; b-- > 0;) {
+                if (this->buckets[b] != 0) {
+                    return highest_of(b);
+                }
+            }
+            return duration::zero();
+        }
+
+    private:
+        static duration highest_of(std::size_t b) noexcept {
+            const std::uint64_t next = b + 1 < bucket_count ? lowest_of(b + 1) : std::uint64_t{ 1 } << max_bits;
+            return duration(static_cast<duration::rep>(next - 1));
+        }
+
+        std::array<std::uint64_t, bucket_count> buckets{};
+    };
+
+    struct transaction_metrics_snapshot
+    {
+        const latency_histogram& latency(transaction_phase phase) const noexcept {
+            return this->phases[static_cast<std::size_t>(phase)];
+        }
+
+        std::uint64_t count(transaction_outcome outcome) const noexcept {
+            return this->outcomes[static_cast<std::size_t>(outcome)];
+        }
+
+        // Rollback of a cancelled transaction resumes the stopped path of its caller directly,
+        // so its latency is not in the rollback histogram
+        std::array<latency_histogram, 4> phases;
+        std::array<std::uint64_t, 4> outcomes{};
+    };
+
+    namespace details {
+
+        // Counters of one thread. Written only by their thread, without a locked instruction,
+        // read with relaxed loads by snapshots.
+        struct transaction_metrics_shard
+        {
+            static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+            void record(transaction_phase phase, std::chrono::steady_clock::duration d) noexcept {
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+                bump(this->phases[static_cast<std::size_t>(phase)][
+                    latency_histogram::bucket_of(static_cast<std::uint64_t>(std::max<decltype(ns)>(ns, 0)))]);
+            }
+
+            void record(transaction_outcome outcome) noexcept {
+                bump(this->outcomes[static_cast<std::size_t>(outcome)]);
+            }
+
+            void add_to(transaction_metrics_snapshot& s) const noexcept {
+                for (std::size_t p = 0; p < this->phases.size(); ++p) {
+                    for (std::size_t b = 0; b < latency_histogram::bucket_count; ++b) {
+                        if (const std::uint64_t n = this->phases[p][b].load(std::memory_order_relaxed)) {
+                            s.phases[p].add(b, n);
+                        }
+                    }
+                }
+                for (std::size_t o = 0; o < this->outcomes.size(); ++o) {
+                    s.outcomes[o] += this->outcomes[o].load(std::memory_order_relaxed);
+                }
+            }
+
+            std::array<std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count>, 4> phases{};
+            std::array<std::atomic<std::uint64_t>, 4> outcomes{};
+            transaction_metrics_shard* prev = nullptr;
+            transaction_metrics_shard* next = nullptr;
+        };
+
+        // Shards of the live threads of one resource type. A thread links its shard on first use
+        // and folds it into retired when it exits, so no count is lost.
+        template<typename Resource>
+        class transaction_metrics_registry
+        {
+        public:
+            static transaction_metrics_shard& local() noexcept {
+                thread_local shard_owner owner;
+                return owner.shard;
+            }
+
+            static transaction_metrics_snapshot snapshot() {
+                std::scoped_lock lock(mutex);
+                transaction_metrics_snapshot s = retired;
+                for (const transaction_metrics_shard* shard = live; shard; shard = shard->next) {
+                    shard->add_to(s);
+                }
+                return s;
+            }
+
+        private:
+            struct shard_owner
+            {
+                shard_owner() noexcept {
+                    std::scoped_lock lock(mutex);
+                    this->shard.next = live;
+                    if (live) {
+                        live->prev = &this->shard;
+                    }
+                    live = &this->shard;
+                }
+
+                ~shard_owner() {
+                    std::scoped_lock lock(mutex);
+                    this->shard.add_to(retired);
+                    if (this->shard.prev) {
+                        this->shard.prev->next = this->shard.next;
+                    } else {
+                        live = this->shard.next;
+                    }
+                    if (this->shard.next) {
+                        this->shard.next->prev = this->shard.prev;
+                    }
+                }
+
+                transaction_metrics_shard shard;
+            };
+
+            static inline std::mutex mutex;
+            static inline transaction_metrics_shard* live = nullptr;
+            static inline transaction_metrics_snapshot retired;
+        };
+
+        // Start of the phase in progress, kept in the promise when metrics are enabled
+        template<typename Resource>
+        struct transaction_timing
+        {
+            using clock = std::chrono::steady_clock;
+
+            void start() noexcept { this->mark = clock::now(); }
+
+            // Record the phase just completed, and start the next one
+            void lap(transaction_phase completed) noexcept {
+                const clock::time_point now = clock::now();
+                transaction_metrics_registry<Resource>::local().record(completed, now - this->mark);
+                this->mark = now;
+            }
+
+            void outcome(transaction_outcome o) noexcept {
+                transaction_metrics_registry<Resource>::local().record(o);
+            }
+
+            clock::time_point mark{};
+        };
+
+        struct no_transaction_timing
+        {
+            constexpr void start() const noexcept {}
+            constexpr void lap(transaction_phase) const noexcept {}
+            constexpr void outcome(transaction_outcome) const noexcept {}
+        };
+
+    } // namespace mylib::details
+
+    // Latencies and outcomes recorded so far by transactions on resources of type Resource, all threads summed
+    template<typename Resource>
+        requires enable_transaction_metrics<Resource>
+    transaction_metrics_snapshot transaction_metrics() {
+        return details::transaction_metrics_registry<Resource>::snapshot();
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_TRANSACTION_METRICS_H
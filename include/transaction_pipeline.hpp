@@ -0,0 +1,155 @@
+#ifndef MYLIB_TRANSACTION_PIPELINE_H
+#define MYLIB_TRANSACTION_PIPELINE_H 1
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+#include <cassert>
+
+#include "detached_task.hpp"
+#include "transaction.hpp"
+
+namespace mylib {
+
+    // Transactional adapter for resources that accept a new request while earlier ones are in flight,
+    // such as a pipelined connection. A commit is issued to the resource and the transaction completes
+    // right away, so the caller can begin the next transaction while the commit is outstanding.
+    // Requests reach the resource in issue order, which keeps their order per resource.
+    // The outcome of issued commits is collected by co_await sync(), which waits for all of them
+    // and rethrows the first failure since the last sync.
+    template<mylib::transactional Resource>
+    class transaction_pipeline
+    {
+    public:
+        using resource_type = Resource;
+
+        class [[nodiscard]] commit_awaiter;
+        class [[nodiscard]] sync_awaiter;
+
+        explicit transaction_pipeline(resource_type& resource) noexcept : resource(&resource) {}
+
+        transaction_pipeline(const transaction_pipeline&) = delete;
+        transaction_pipeline& operator=(const transaction_pipeline&) = delete;
+
+        ~transaction_pipeline() {
+            assert(this->in_flight == 0 && "Commits still in flight, sync first.");
+        }
+
+        decltype(auto) transaction_begin() { return mylib::transaction_begin(*this->resource); }
+
+        decltype(auto) transaction_rollback() { return mylib::transaction_rollback(*this->resource); }
+
+        commit_awaiter transaction_commit() noexcept { return commit_awaiter(*this); }
+
+        // At most one sync pending at a time
+        sync_awaiter sync() noexcept { return sync_awaiter(*this); }
+
+        std::size_t pending() const noexcept {
+            std::scoped_lock lock(this->mutex);
+            return this->in_flight;
+        }
+
+        resource_type& underlying() const noexcept { return *this->resource; }
+
+    private:
+        static mylib::detached_task run_commit(transaction_pipeline& self) {
+            std::exception_ptr failure;
+            try {
+                co_await mylib::transaction_commit(*self.resource);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            std::coroutine_handle<> waiter = nullptr;
+            {
+                std::scoped_lock lock(self.mutex);
+                if (failure && !self.failure) {
+                    self.failure = std::move(failure);
+                }
+                if (--self.in_flight == 0) {
+                    waiter = std::exchange(self.sync_waiter, nullptr);
+                }
+            }
+            if (waiter) {
+                waiter.resume();
+            }
+        }
+
+        mutable std::mutex mutex;
+        resource_type* resource;
+        std::size_t in_flight = 0;
+        std::exception_ptr failure;
+        std::coroutine_handle<> sync_waiter = nullptr;
+    };
+
+    template<mylib::transactional Resource>
+    class [[nodiscard]] transaction_pipeline<Resource>::commit_awaiter
+    {
+    public:
+        commit_awaiter(const commit_awaiter&) = delete;
+        commit_awaiter& operator=(const commit_awaiter&) = delete;
+
+        constexpr bool await_ready() const noexcept { return false; }
+
+        // Issue the commit, it runs until it first suspends, then go on without it.
+        // Counted only once its frame exists, so a failed allocation leaves no commit in flight.
+        bool await_suspend(std::coroutine_handle<>) {
+            mylib::detached_task commit = run_commit(*this->owner);
+            {
+                std::scoped_lock lock(this->owner->mutex);
+                ++this->owner->in_flight;
+            }
+            std::move(commit).start();
+            return false;
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+    private:
+        friend transaction_pipeline;
+
+        explicit commit_awaiter(transaction_pipeline& owner) noexcept : owner(&owner) {}
+
+        transaction_pipeline* owner;
+    };
+
+    template<mylib::transactional Resource>
+    class [[nodiscard]] transaction_pipeline<Resource>::sync_awaiter
+    {
+    public:
+        bool await_ready() const noexcept { return this->owner->pending() == 0; }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            std::scoped_lock lock(this->owner->mutex);
+            if (this->owner->in_flight == 0) {
+                return false;
+            }
+            assert(!this->owner->sync_waiter && "Another sync is pending.");
+            this->owner->sync_waiter = h;
+            return true;
+        }
+
+        void await_resume() const {
+            std::exception_ptr failure;
+            {
+                std::scoped_lock lock(this->owner->mutex);
+                failure = std::exchange(this->owner->failure, nullptr);
+            }
+            if (failure) {
+                std::rethrow_exception(std::move(failure));
+            }
+        }
+
+    private:
+        friend transaction_pipeline;
+
+        explicit sync_awaiter(transaction_pipeline& owner) noexcept : owner(&owner) {}
+
+        transaction_pipeline* owner;
+    };
+
+} // namespace mylib
+
+#endif // MYLIB_TRANSACTION_PIPELINE_H
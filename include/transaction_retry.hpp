@@ -0,0 +1,94 @@
+#ifndef MYLIB_TRANSACTION_RETRY_H
+#define MYLIB_TRANSACTION_RETRY_H 1
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+#include "awaitable_traits.hpp"
+#include "task.hpp"
+#include "timer_wheel.hpp"
+#include "transaction.hpp"
+
+namespace mylib {
+
+    namespace details {
+
+        template<typename Arg>
+        concept member_is_conflict = requires (Arg&& arg, const std::exception_ptr& e) {
+            { std::forward<Arg>(arg).transaction_is_conflict(e) } -> std::convertible_to<bool>;
+        };
+
+        template<typename Arg>
+        concept adl_is_conflict = requires (Arg&& arg, const std::exception_ptr& e) {
+            { transaction_is_conflict(std::forward<Arg>(arg), e) } -> std::convertible_to<bool>;
+        };
+
+        struct transaction_is_conflict_cpo {
+            template<typename Arg>
+            bool operator() (Arg&& arg, const std::exception_ptr& e) const noexcept {
+                if constexpr (member_is_conflict<Arg>) {
+                    return std::forward<Arg>(arg).transaction_is_conflict(e);
+                } else if constexpr (adl_is_conflict<Arg>) {
+                    return transaction_is_conflict(std::forward<Arg>(arg), e);
+                } else {
+                    return false;
+                }
+            }
+        };
+
+    } // namespace mylib::details
+
+    // Optional: true if the transaction failed with e only because of a conflict,
+    // so running it again may succeed. Without it nothing is retried.
+    inline constexpr details::transaction_is_conflict_cpo transaction_is_conflict{};
+
+    struct retry_policy
+    {
+        // Attempts in total, the first one included
+        std::size_t max_attempts = 5;
+        timer_wheel::duration base_delay = std::chrono::milliseconds(1);
+        timer_wheel::duration max_delay = std::chrono::milliseconds(100);
+
+        // Full jitter: uniform in [0, min(max_delay, base_delay * 2^(attempt - 1))]
+        timer_wheel::duration backoff(std::size_t attempt) const {
+            thread_local std::minstd_rand engine{ std::random_device{}() };
+            const unsigned shift = static_cast<unsigned>(std::min<std::size_t>(attempt - 1, 30));
+            const auto cap = std::min(this->max_delay, this->base_delay * (timer_wheel::duration::rep{ 1 } << shift));
+            std::uniform_int_distribution<timer_wheel::duration::rep> pick(0, cap.count());
+            return timer_wheel::duration(pick(engine));
+        }
+    };
+
+    // co_await retry_transaction(db, wheel, [&] { return txn(db); }) runs the transaction made by make,
+    // and as long as it fails with a conflict of resource and attempts are left, sleeps a jittered
+    // exponential backoff on wheel and runs a new one. Each failed attempt is rolled back as usual.
+    // The frame of a failed attempt is freed before the next one is made, which then reuses it
+    // from the frame pool, so retrying allocates nothing. The sleep observes the stop token.
+    template<mylib::transactional Resource, std::invocable MakeTransaction>
+    auto retry_transaction(Resource& resource, timer_wheel& wheel, MakeTransaction make, retry_policy policy = {})
+        -> mylib::task<details::await_result_t<std::invoke_result_t<MakeTransaction&>>>
+    {
+        for (std::size_t attempt = 1;; ++attempt) {
+            std::exception_ptr failure;
+            try {
+                co_return co_await std::invoke(make);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            if (attempt >= policy.max_attempts || !mylib::transaction_is_conflict(resource, failure)) {
+                std::rethrow_exception(std::move(failure));
+            }
+            co_await wheel.sleep_for(policy.backoff(attempt));
+        }
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_TRANSACTION_RETRY_H
@@ -0,0 +1,386 @@
+#ifndef MYLIB_WHEN_ALL_H
+#define MYLIB_WHEN_ALL_H 1
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "cancellation.hpp"
+#include "stop_token.hpp"
+#include "task.hpp"
+
+namespace mylib {
+
+    namespace details {
+
+        template<typename T>
+        using when_all_value_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+        // Range form keeps results in a vector, so references are held as std::reference_wrapper
+        template<typename T>
+        using when_all_element_t = std::conditional_t<std::is_lvalue_reference_v<T>,
+            std::reference_wrapper<std::remove_reference_t<T>>, T>;
+
+        template<typename T>
+        using when_any_value_t = std::conditional_t<std::is_void_v<T>, std::monostate,
+            std::conditional_t<std::is_lvalue_reference_v<T>, std::reference_wrapper<std::remove_reference_t<T>>, T>>;
+
+        template<typename Awaiter>
+        when_all_value_t<typename Awaiter::return_type> joined_result(Awaiter& a) {
+            if constexpr (std::is_void_v<typename Awaiter::return_type>) {
+                a.await_resume();
+                return {};
+            } else {
+                return a.await_resume();
+            }
+        }
+
+        // Shared by the children of one combinator: a single countdown, started at child count + 1
+        // so that the children finishing while still being started cannot resume the parent early.
+        class join_counter : public task_join
+        {
+        public:
+            constexpr static std::size_t no_winner = std::numeric_limits<std::size_t>::max();
+
+            join_counter(complete_fn fn, std::size_t children) noexcept
+                : task_join{ fn }, count(children + 1)
+            {}
+
+            // when_all children share the stop token of the parent; when_any children get one of
+            // the combinator, stopped when the parent is asked to stop or a winner is known
+            template<typename PromiseType>
+            void set_continuation(std::coroutine_handle<PromiseType> h) noexcept {
+                this->continuation = h;
+                if constexpr (mylib::has_unhandled_stopped<PromiseType>) {
+                    this->stopped_handler = &mylib::forward_stopped_handler<PromiseType>;
+                } else {
+                    this->stopped_handler = &mylib::null_stopped_handler;
+                }
+                const mylib::inplace_stop_token parent_token = mylib::get_stop_token_of(h.promise());
+                if (this->complete == &any_complete) {
+                    this->parent_stop.emplace(parent_token, forward_stop{ &this->losers });
+                    this->child_token = this->losers.get_token();
+                } else {
+                    this->child_token = parent_token;
+                }
+            }
+
+            mylib::inplace_stop_token children_stop_token() const noexcept {
+                return this->child_token;
+            }
+
+            // Drop one reference, the last one resumes the parent,
+            // through its stopped path if the combinator completed stopped
+            std::coroutine_handle<> arrive() noexcept {
+                if (this->count.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    return std::noop_coroutine();
+                }
+                if (this->completed_stopped()) {
+                    return this->stopped_handler(this->continuation.address());
+                }
+                return this->continuation;
+            }
+
+            // when_all: any child stopped
+            static std::coroutine_handle<> all_complete(task_join& j, std::size_t, bool stopped) noexcept {
+                join_counter& self = static_cast<join_counter&>(j);
+                if (stopped) {
+                    self.stopped.store(true, std::memory_order_relaxed);
+                }
+                return self.arrive();
+            }
+
+            // when_any: the first child completing with a value or an exception wins
+            static std::coroutine_handle<> any_complete(task_join& j, std::size_t index, bool stopped) noexcept {
+                join_counter& self = static_cast<join_counter&>(j);
+                if (!stopped) {
+                    std::size_t expected = no_winner;
+                    if (self.winner.compare_exchange_strong(expected, index, std::memory_order_relaxed)) {
+                        // Losers completing stopped from here cannot be last, this child has not arrived yet
+                        self.losers.request_stop();
+                    }
+                }
+                return self.arrive();
+            }
+
+            std::size_t winner_index() const noexcept {
+                return this->winner.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct forward_stop
+            {
+                void operator()() noexcept { this->source->request_stop(); }
+
+                mylib::inplace_stop_source* source;
+            };
+
+            bool completed_stopped() const noexcept {
+                if (this->complete == &any_complete) {
+                    return this->winner.load(std::memory_order_relaxed) == no_winner;
+                }
+                return this->stopped.load(std::memory_order_relaxed);
+            }
+
+            std::atomic<std::size_t> count;
+            std::atomic<std::size_t> winner = no_winner;
+            std::atomic<bool> stopped = false;
+            std::coroutine_handle<> continuation = nullptr;
+            mylib::stopped_handler_type stopped_handler = &mylib::null_stopped_handler;
+            mylib::inplace_stop_token child_token;
+            mylib::inplace_stop_source losers;
+            std::optional<mylib::inplace_stop_callback<forward_stop>> parent_stop;
+        };
+
+        // Children are held as task awaiters, which own the child frames until the combinator is destroyed.
+        // Not movable: the children refer to the counter once started.
+        template<typename Derived>
+        class [[nodiscard]] join_awaiter_base
+        {
+        public:
+            join_awaiter_base(const join_awaiter_base&) = delete;
+            join_awaiter_base& operator=(const join_awaiter_base&) = delete;
+
+            bool await_ready() const noexcept {
+                return static_cast<const Derived&>(*this).child_count() == 0;
+            }
+
+            template<typename PromiseType>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> h) noexcept {
+                this->counter.set_continuation(h);
+                static_cast<Derived&>(*this).start_children();
+                return this->counter.arrive();
+            }
+
+        protected:
+            join_awaiter_base(task_join::complete_fn fn, std::size_t children) noexcept
+                : counter(fn, children)
+            {}
+
+            join_counter counter;
+        };
+
+        template<typename... Awaiters>
+        class when_all_awaiter : public join_awaiter_base<when_all_awaiter<Awaiters...>>
+        {
+        public:
+            using result_type = std::tuple<when_all_value_t<typename Awaiters::return_type>...>;
+
+            explicit when_all_awaiter(Awaiters&&... children) noexcept
+                : join_awaiter_base<when_all_awaiter>(&join_counter::all_complete, sizeof...(Awaiters))
+                , children(std::move(children)...)
+            {}
+
+            // Exception of the first failed child is rethrown
+            result_type await_resume() {
+                return std::apply([](Awaiters&... a) {
+                    return result_type{ joined_result(a)... };
+                }, this->children);
+            }
+
+            constexpr std::size_t child_count() const noexcept { return sizeof...(Awaiters); }
+
+            void start_children() noexcept {
+                [this]<std::size_t... I>(std::index_sequence<I...>) {
+                    (std::get<I>(this->children).start_joined(this->counter, I, this->counter.children_stop_token()), ...);
+                }(std::index_sequence_for<Awaiters...>{});
+            }
+
+        private:
+            std::tuple<Awaiters...> children;
+        };
+
+        template<typename Awaiters>
+        class when_all_range_awaiter : public join_awaiter_base<when_all_range_awaiter<Awaiters>>
+        {
+        public:
+            using value_type = typename Awaiters::value_type::return_type;
+            using result_type = std::conditional_t<std::is_void_v<value_type>, void, std::vector<when_all_element_t<value_type>>>;
+
+            explicit when_all_range_awaiter(Awaiters&& children) noexcept
+                : join_awaiter_base<when_all_range_awaiter>(&join_counter::all_complete, children.size())
+                , children(std::move(children))
+            {}
+
+            result_type await_resume() {
+                if constexpr (std::is_void_v<value_type>) {
+                    for (auto& a : this->children) {
+                        a.await_resume();
+                    }
+                } else {
+                    result_type results;
+                    results.reserve(this->children.size());
+                    for (auto& a : this->children) {
+                        results.push_back(a.await_resume());
+                    }
+                    return results;
+                }
+            }
+
+            std::size_t child_count() const noexcept { return this->children.size(); }
+
+            void start_children() noexcept {
+                for (std::size_t i = 0; i < this->children.size(); ++i) {
+                    this->children[i].start_joined(this->counter, i, this->counter.children_stop_token());
+                }
+            }
+
+        private:
+            Awaiters children;
+        };
+
+        template<typename... Awaiters>
+        class when_any_awaiter : public join_awaiter_base<when_any_awaiter<Awaiters...>>
+        {
+        public:
+            using result_type = std::variant<when_any_value_t<typename Awaiters::return_type>...>;
+
+            explicit when_any_awaiter(Awaiters&&... children) noexcept
+                : join_awaiter_base<when_any_awaiter>(&join_counter::any_complete, sizeof...(Awaiters))
+                , children(std::move(children)...)
+            {}
+
+            // Result of the winner, its index is the index of the variant
+            result_type await_resume() {
+                return this->result_of(this->counter.winner_index(), std::index_sequence_for<Awaiters...>{});
+            }
+
+            constexpr std::size_t child_count() const noexcept { return sizeof...(Awaiters); }
+
+            void start_children() noexcept {
+                [this]<std::size_t... I>(std::index_sequence<I...>) {
+                    (std::get<I>(this->children).start_joined(this->counter, I, this->counter.children_stop_token()), ...);
+                }(std::index_sequence_for<Awaiters...>{});
+            }
+
+        private:
+            template<std::size_t I, std::size_t... Rest>
+            result_type result_of(std::size_t winner, std::index_sequence<I, Rest...>) {
+                if (winner == I) {
+                    return result_type(std::in_place_index<I>, joined_result(std::get<I>(this->children)));
+                }
+                if constexpr (sizeof...(Rest) > 0) {
+                    return this->result_of(winner, std::index_sequence<Rest...>{});
+                } else {
+                    std::unreachable();
+                }
+            }
+
+            std::tuple<Awaiters...> children;
+        };
+
+        template<typename Awaiters>
+        class when_any_range_awaiter : public join_awaiter_base<when_any_range_awaiter<Awaiters>>
+        {
+        public:
+            using value_type = typename Awaiters::value_type::return_type;
+            using result_type = std::conditional_t<std::is_void_v<value_type>,
+                std::size_t, std::pair<std::size_t, when_any_value_t<value_type>>>;
+
+            explicit when_any_range_awaiter(Awaiters&& children) noexcept
+                : join_awaiter_base<when_any_range_awaiter>(&join_counter::any_complete, children.size())
+                , children(std::move(children))
+            {
+                assert(!this->children.empty() && "when_any of no task.");
+            }
+
+            // Index of the winner, with its result unless void
+            result_type await_resume() {
+                const std::size_t winner = this->counter.winner_index();
+                if constexpr (std::is_void_v<value_type>) {
+                    this->children[winner].await_resume();
+                    return winner;
+                } else {
+                    return result_type(winner, this->children[winner].await_resume());
+                }
+            }
+
+            std::size_t child_count() const noexcept { return this->children.size(); }
+
+            void start_children() noexcept {
+                for (std::size_t i = 0; i < this->children.size(); ++i) {
+                    this->children[i].start_joined(this->counter, i, this->counter.children_stop_token());
+                }
+            }
+
+        private:
+            Awaiters children;
+        };
+
+        template<typename Range>
+        auto to_task_awaiters(Range&& tasks) {
+            using task_type = std::ranges::range_value_t<Range>;
+            std::vector<typename task_type::task_awaiter> awaiters;
+            if constexpr (std::ranges::sized_range<Range>) {
+                awaiters.reserve(std::ranges::size(tasks));
+            }
+            for (auto&& t : tasks) {
+                awaiters.push_back(std::move(t).operator co_await());
+            }
+            return awaiters;
+        }
+
+        // Tasks whose policy lets a combinator start them
+        template<typename T>
+        constexpr bool is_joinable_task_v = false;
+
+        template<typename ReturnType, typename Policy>
+        constexpr bool is_joinable_task_v<mylib::task<ReturnType, Policy>> = policy_joinable<Policy>;
+
+    } // namespace mylib::details
+
+    // co_await when_all(t0, t1, ...) runs the tasks concurrently and resumes once all completed.
+    // Gives a tuple of their results, void as std::monostate; if any child completed stopped,
+    // the awaiting coroutine completes stopped, otherwise the first failed child's exception is rethrown.
+    template<typename... ReturnTypes, typename... Policies>
+        requires (details::policy_joinable<Policies> && ...)
+    auto when_all(mylib::task<ReturnTypes, Policies>&&... tasks) {
+        return details::when_all_awaiter<typename mylib::task<ReturnTypes, Policies>::task_awaiter...>(
+            std::move(tasks).operator co_await()...
+        );
+    }
+
+    // Range form, gives a vector of the results, or void for tasks of void.
+    // Results of tasks returning T& are std::reference_wrapper<T>, tasks returning T&& are not accepted.
+    template<std::ranges::input_range Range>
+        requires details::is_joinable_task_v<std::ranges::range_value_t<Range>>
+            && (!std::is_rvalue_reference_v<typename std::ranges::range_value_t<Range>::return_type>)
+    auto when_all(Range&& tasks) {
+        using awaiters = decltype(details::to_task_awaiters(std::forward<Range>(tasks)));
+        return details::when_all_range_awaiter<awaiters>(details::to_task_awaiters(std::forward<Range>(tasks)));
+    }
+
+    // co_await when_any(t0, t1, ...) gives a variant holding the result of the first task to complete
+    // with a value or an exception, at the index of that task. The other children are then asked to stop
+    // through their stop token, and still joined before the awaiting coroutine resumes, so child frames
+    // never outlive it. Completes stopped if all children stopped.
+    template<typename... ReturnTypes, typename... Policies>
+        requires (sizeof...(ReturnTypes) > 0) && (details::policy_joinable<Policies> && ...)
+    auto when_any(mylib::task<ReturnTypes, Policies>&&... tasks) {
+        return details::when_any_awaiter<typename mylib::task<ReturnTypes, Policies>::task_awaiter...>(
+            std::move(tasks).operator co_await()...
+        );
+    }
+
+    // Range form, gives the winner index paired with its result, or only the index for tasks of void
+    template<std::ranges::input_range Range>
+        requires details::is_joinable_task_v<std::ranges::range_value_t<Range>>
+    auto when_any(Range&& tasks) {
+        using awaiters = decltype(details::to_task_awaiters(std::forward<Range>(tasks)));
+        return details::when_any_range_awaiter<awaiters>(details::to_task_awaiters(std::forward<Range>(tasks)));
+    }
+
+} // namespace mylib
+
+#endif // MYLIB_WHEN_ALL_H
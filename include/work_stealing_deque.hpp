@@ -0,0 +1,126 @@
+#ifndef MYLIB_WORK_STEALING_DEQUE_H
+#define MYLIB_WORK_STEALING_DEQUE_H 1
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mylib {
+
+    // Chase-Lev work-stealing deque of coroutine handles
+    // (memory orders follow Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+    // push and take may only be called by the owning thread, steal by any thread.
+    class work_stealing_deque
+    {
+    public:
+        explicit work_stealing_deque(std::size_t capacity = 256)
+            : ring(new_ring(capacity))
+        {}
+
+        work_stealing_deque(const work_stealing_deque&) = delete;
+        work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+        ~work_stealing_deque() = default;
+
+        void push(std::coroutine_handle<> h) {
+            const std::int64_t b = this->bottom.load(std::memory_order_relaxed);
+            const std::int64_t t = this->top.load(std::memory_order_acquire);
+            ring_type* r = this->ring.load(std::memory_order_relaxed);
+            if (b - t > static_cast<std::int64_t>(r->mask)) [[unlikely]] {
+                r = this->grow(r, t, b);
+            }
+            r->put(b, h.address());
+            this->bottom.store(b + 1, std::memory_order_release);
+        }
+
+        // Pop from the owner's end, null if empty
+        std::coroutine_handle<> take() noexcept {
+            const std::int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+            ring_type* r = this->ring.load(std::memory_order_relaxed);
+            this->bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = this->top.load(std::memory_order_relaxed);
+            if (t > b) {
+                this->bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            void* item = r->get(b);
+            if (t == b) {
+                // Last element, race against thieves
+                if (!this->top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                this->bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return std::coroutine_handle<>::from_address(item);
+        }
+
+        // Pop from the other end, null if empty or lost a race
+        std::coroutine_handle<> steal() noexcept {
+            std::int64_t t = this->top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const std::int64_t b = this->bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            void* item = this->ring.load(std::memory_order_acquire)->get(t);
+            if (!this->top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return std::coroutine_handle<>::from_address(item);
+        }
+
+        bool empty() const noexcept {
+            const std::int64_t b = this->bottom.load(std::memory_order_relaxed);
+            const std::int64_t t = this->top.load(std::memory_order_relaxed);
+            return b <= t;
+        }
+
+    private:
+        struct ring_type
+        {
+            std::size_t mask;
+            std::unique_ptr<std::atomic<void*>[]> slots;
+
+            void put(std::int64_t i, void* p) noexcept {
+                this->slots[static_cast<std::size_t>(i) & this->mask].store(p, std::memory_order_relaxed);
+            }
+
+            void* get(std::int64_t i) const noexcept {
+                return this->slots[static_cast<std::size_t>(i) & this->mask].load(std::memory_order_relaxed);
+            }
+        };
+
+        ring_type* new_ring(std::size_t capacity) {
+            std::size_t size = 1;
+            while (size < capacity) { size <<= 1; }
+            auto& r = this->rings.emplace_back(
+                std::make_unique<ring_type>(size - 1, std::make_unique<std::atomic<void*>[]>(size))
+            );
+            return r.get();
+        }
+
+        // Thieves may still read the old ring, so it is only freed with the deque
+        ring_type* grow(ring_type* old, std::int64_t t, std::int64_t b) {
+            ring_type* r = this->new_ring((old->mask + 1) * 2);
+            for (std::int64_t i = t; i < b; ++i) {
+                r->put(i, old->get(i));
+            }
+            this->ring.store(r, std::memory_order_release);
+            return r;
+        }
+
+        alignas(64) std::atomic<std::int64_t> top = 0;
+        alignas(64) std::atomic<std::int64_t> bottom = 0;
+        std::vector<std::unique_ptr<ring_type>> rings;
+        std::atomic<ring_type*> ring;
+    };
+
+} // namespace mylib
+
+#endif // MYLIB_WORK_STEALING_DEQUE_H
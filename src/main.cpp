@@ -7,6 +7,7 @@
 #include "detached_task.hpp"
 #include "callcc.hpp"
 #include "transaction.hpp"
+#include "sync_wait.hpp"
 
 mylib::task<int> work() {
     std::println("Work, work");
@@ -201,5 +202,5 @@ int main() {
             std::println("Nested exception: \"{}\"", ne.what());
         }
     }
-    return a_main().sync_await();
+    return mylib::sync_wait(a_main());
 }
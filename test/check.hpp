@@ -0,0 +1,18 @@
+#ifndef MYLIB_TEST_CHECK_H
+#define MYLIB_TEST_CHECK_H 1
+
+#include <cstdlib>
+#include <print>
+#include <source_location>
+
+// Fails the test program at once, also in release builds where assert is gone
+inline void check(bool condition, const char* what, std::source_location where = std::source_location::current()) {
+    if (!condition) {
+        std::println(stderr, "{}:{}: check failed: {}", where.file_name(), where.line(), what);
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+#define CHECK(...) check(static_cast<bool>(__VA_ARGS__), #__VA_ARGS__)
+
+#endif // MYLIB_TEST_CHECK_H
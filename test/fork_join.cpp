@@ -0,0 +1,112 @@
+#include <atomic>
+#include <cstddef>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "check.hpp"
+#include "fork_join.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+mylib::fork_join_task<long> fib(int n) {
+    if (n < 2) {
+        co_return n;
+    }
+    long a = 0;
+    long b = 0;
+    co_await mylib::spawn(fib(n - 1), a);
+    co_await mylib::spawn(fib(n - 2), b);
+    co_await mylib::sync();
+    co_return a + b;
+}
+
+// Several spawns per sync, and more than one sync per frame
+mylib::fork_join_task<long> sum(std::span<const long> values) {
+    if (values.size() <= 16) {
+        co_return std::accumulate(values.begin(), values.end(), 0L);
+    }
+    const std::size_t quarter = values.size() / 4;
+    long parts[4] = {};
+    co_await mylib::spawn(sum(values.first(quarter)), parts[0]);
+    co_await mylib::spawn(sum(values.subspan(quarter, quarter)), parts[1]);
+    co_await mylib::sync();
+    co_await mylib::spawn(sum(values.subspan(2 * quarter, quarter)), parts[2]);
+    co_await mylib::spawn(sum(values.subspan(3 * quarter)), parts[3]);
+    co_await mylib::sync();
+    co_return parts[0] + parts[1] + parts[2] + parts[3];
+}
+
+mylib::fork_join_task<void> fail_leaves(int depth, std::atomic<int>& ran) {
+    ran.fetch_add(1, std::memory_order_relaxed);
+    if (depth == 0) {
+        throw std::runtime_error("leaf");
+    }
+    co_await mylib::spawn(fail_leaves(depth - 1, ran));
+    co_await mylib::spawn(fail_leaves(depth - 1, ran));
+    co_await mylib::sync();
+}
+
+// Throws with children still running: their results must not reach the dead slots
+mylib::fork_join_task<long> throw_before_sync(std::atomic<int>& ran) {
+    long results[8] = {};
+    for (long& r : results) {
+        co_await mylib::spawn([](std::atomic<int>& ran) -> mylib::fork_join_task<long> {
+            long a = 0;
+            long b = 0;
+            co_await mylib::spawn(fib(12), a);
+            co_await mylib::spawn(fib(11), b);
+            co_await mylib::sync();
+            ran.fetch_add(1, std::memory_order_relaxed);
+            co_return a + b;
+        }(ran), r);
+    }
+    throw std::runtime_error("parent");
+}
+
+template<typename ReturnType>
+mylib::task<ReturnType> on_pool(mylib::thread_pool& pool, mylib::fork_join_task<ReturnType> task) {
+    co_await pool.schedule();
+    co_return co_await std::move(task);
+}
+
+int main() {
+    // Off the pool spawn is a plain call
+    CHECK(mylib::sync_wait(fib(15)) == 610);
+
+    std::vector<long> values(10000);
+    std::iota(values.begin(), values.end(), 1L);
+    const long expected = 10000L * 10001L / 2;
+    {
+        mylib::thread_pool pool(4);
+        for (int i = 0; i < 8; ++i) {
+            CHECK(mylib::sync_wait(on_pool(pool, fib(18))) == 2584);
+            CHECK(mylib::sync_wait(on_pool(pool, sum(values))) == expected);
+        }
+
+        std::atomic<int> ran = 0;
+        bool caught = false;
+        try {
+            mylib::sync_wait(on_pool(pool, fail_leaves(5, ran)));
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        CHECK(caught);
+        CHECK(ran.load() == 63);
+
+        for (int i = 0; i < 8; ++i) {
+            std::atomic<int> finished = 0;
+            caught = false;
+            try {
+                mylib::sync_wait(on_pool(pool, throw_before_sync(finished)));
+            } catch (const std::runtime_error&) {
+                caught = true;
+            }
+            CHECK(caught);
+            CHECK(finished.load() == 8);
+        }
+    }
+    std::println("fork_join: ok");
+}
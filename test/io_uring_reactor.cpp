@@ -0,0 +1,140 @@
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "check.hpp"
+#include "detached_task.hpp"
+#include "io_uring_reactor.hpp"
+
+constexpr std::string_view message = "ping over loopback";
+
+std::span<const std::byte> bytes_of(std::string_view s) {
+    return std::as_bytes(std::span(s.data(), s.size()));
+}
+
+mylib::detached_task echo_server(mylib::io_uring_reactor& reactor, int listener, bool& done) {
+    const int conn = co_await reactor.accept(listener);
+    std::array<std::byte, 64> buffer;
+    const int n = co_await reactor.recv(conn, buffer);
+    co_await reactor.send(conn, std::span(buffer.data(), static_cast<std::size_t>(n)));
+    ::close(conn);
+    done = true;
+}
+
+mylib::detached_task echo_client(mylib::io_uring_reactor& reactor, const ::sockaddr_in& addr, bool& done) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    co_await reactor.connect(fd, reinterpret_cast<const ::sockaddr*>(&addr), sizeof(addr));
+    co_await reactor.send(fd, bytes_of(message));
+    std::array<char, 64> buffer{};
+    std::size_t received = 0;
+    while (received < message.size()) {
+        const int n = co_await reactor.recv(fd, std::as_writable_bytes(std::span(buffer)).subspan(received));
+        CHECK(n > 0);
+        received += static_cast<std::size_t>(n);
+    }
+    CHECK(std::string_view(buffer.data(), received) == message);
+    ::close(fd);
+    done = true;
+}
+
+void tcp_echo() {
+    mylib::io_uring_reactor reactor;
+    const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(::bind(listener, reinterpret_cast<::sockaddr*>(&addr), sizeof(addr)) == 0);
+    CHECK(::listen(listener, 1) == 0);
+    ::socklen_t len = sizeof(addr);
+    CHECK(::getsockname(listener, reinterpret_cast<::sockaddr*>(&addr), &len) == 0);
+
+    bool server_done = false;
+    bool client_done = false;
+    echo_server(reactor, listener, server_done).start();
+    echo_client(reactor, addr, client_done).start();
+    while (!(server_done && client_done)) {
+        reactor.run_once();
+    }
+    CHECK(reactor.in_flight() == 0);
+    ::close(listener);
+}
+
+mylib::detached_task pipe_round_trip(mylib::io_uring_reactor& reactor, int in, int out, bool& done) {
+    CHECK(co_await reactor.write(out, bytes_of(message)) == static_cast<int>(message.size()));
+    std::array<char, 8> head{};
+    std::array<char, 64> tail{};
+    const std::array<::iovec, 2> buffers{ {
+        { head.data(), head.size() },
+        { tail.data(), tail.size() },
+    } };
+    const int n = co_await reactor.readv(in, buffers);
+    CHECK(n == static_cast<int>(message.size()));
+    CHECK(std::string_view(head.data(), head.size()) == message.substr(0, head.size()));
+    CHECK(std::string_view(tail.data(), n - head.size()) == message.substr(head.size()));
+    done = true;
+}
+
+mylib::detached_task bad_descriptor(mylib::io_uring_reactor& reactor, bool& done) {
+    std::array<std::byte, 8> buffer;
+    try {
+        co_await reactor.read(-1, buffer);
+    } catch (const std::system_error& e) {
+        done = e.code().value() == EBADF;
+    }
+}
+
+void pipe_and_errors() {
+    mylib::io_uring_reactor reactor;
+    int fds[2];
+    CHECK(::pipe(fds) == 0);
+    bool piped = false;
+    bool failed = false;
+    pipe_round_trip(reactor, fds[0], fds[1], piped).start();
+    bad_descriptor(reactor, failed).start();
+    while (reactor.in_flight() > 0) {
+        reactor.run_once();
+    }
+    CHECK(piped);
+    CHECK(failed);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+mylib::detached_task write_one(mylib::io_uring_reactor& reactor, int out, int& written) {
+    written += co_await reactor.write(out, bytes_of(message.substr(0, 1)));
+}
+
+// More operations queued than the ring holds, submitted as the kernel frees entries
+void queue_beyond_ring() {
+    mylib::io_uring_reactor reactor(4);
+    int fds[2];
+    CHECK(::pipe(fds) == 0);
+    int written = 0;
+    for (int i = 0; i < 32; ++i) {
+        write_one(reactor, fds[1], written).start();
+    }
+    while (reactor.in_flight() > 0) {
+        reactor.run_once();
+    }
+    CHECK(written == 32);
+    std::array<char, 64> buffer{};
+    CHECK(::read(fds[0], buffer.data(), buffer.size()) == 32);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int main() {
+    tcp_echo();
+    pipe_and_errors();
+    queue_beyond_ring();
+    std::println("io_uring_reactor: ok");
+}
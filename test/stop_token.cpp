@@ -0,0 +1,161 @@
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+
+#include "cancellation.hpp"
+#include "check.hpp"
+#include "detached_task.hpp"
+#include "stop_token.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "timer_wheel.hpp"
+#include "when_all.hpp"
+
+struct count_call
+{
+    void operator()() noexcept { ++*this->calls; }
+    int* calls;
+};
+
+void callbacks_run_once() {
+    mylib::inplace_stop_source source;
+    const mylib::inplace_stop_token token = source.get_token();
+    CHECK(token.stop_possible());
+    CHECK(!token.stop_requested());
+
+    int first = 0;
+    int second = 0;
+    int removed = 0;
+    int late = 0;
+    mylib::inplace_stop_callback a(token, count_call{ &first });
+    mylib::inplace_stop_callback b(token, count_call{ &second });
+    {
+        mylib::inplace_stop_callback c(token, count_call{ &removed });
+    }
+    CHECK(source.request_stop());
+    CHECK(!source.request_stop());
+    CHECK(token.stop_requested());
+    CHECK(first == 1 && second == 1 && removed == 0);
+
+    // Registered after the request, runs in the constructor
+    mylib::inplace_stop_callback d(token, count_call{ &late });
+    CHECK(late == 1);
+
+    int never = 0;
+    mylib::inplace_stop_callback e(mylib::inplace_stop_token(), count_call{ &never });
+    CHECK(never == 0);
+}
+
+struct reset_self;
+using self_callback = mylib::inplace_stop_callback<reset_self>;
+
+struct reset_self
+{
+    void operator()() noexcept { this->self->reset(); }
+    std::optional<self_callback>* self;
+};
+
+void callback_destroys_itself() {
+    mylib::inplace_stop_source source;
+    std::optional<self_callback> callback;
+    callback.emplace(source.get_token(), reset_self{ &callback });
+    CHECK(source.request_stop());
+    CHECK(!callback.has_value());
+}
+
+// Deregistering from another thread waits for the running callback to return
+void deregistration_waits_for_callback() {
+    mylib::inplace_stop_source source;
+    std::atomic<bool> started = false;
+    std::atomic<bool> finished = false;
+    auto slow = [&]() noexcept {
+        started.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        finished.store(true);
+    };
+    std::optional<mylib::inplace_stop_callback<decltype(slow)>> callback;
+    callback.emplace(source.get_token(), slow);
+    std::thread requester([&] { source.request_stop(); });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    callback.reset();
+    CHECK(finished.load());
+    requester.join();
+}
+
+mylib::task<mylib::inplace_stop_token> inner_token() {
+    co_return co_await mylib::get_stop_token();
+}
+
+mylib::task<mylib::inplace_stop_token> outer_token() {
+    co_return co_await inner_token();
+}
+
+mylib::task<int> checkpoint() {
+    co_await mylib::stop_checkpoint();
+    co_return 1;
+}
+
+template<typename ReturnType>
+mylib::task<ReturnType> under(mylib::inplace_stop_token token, mylib::task<ReturnType> t) {
+    co_return co_await mylib::with_stop_token(token, std::move(t));
+}
+
+void token_propagates_down_the_chain() {
+    mylib::inplace_stop_source source;
+    CHECK(mylib::sync_wait(under(source.get_token(), outer_token())) == source.get_token());
+    CHECK(mylib::sync_wait(under(source.get_token(), checkpoint())) == 1);
+
+    source.request_stop();
+    bool stopped = false;
+    try {
+        mylib::sync_wait(under(source.get_token(), checkpoint()));
+    } catch (const mylib::sync_wait_stopped_exception&) {
+        stopped = true;
+    }
+    CHECK(stopped);
+}
+
+mylib::task<void> sleep_long(mylib::timer_wheel& wheel) {
+    co_await wheel.sleep_for(std::chrono::hours(1));
+}
+
+mylib::detached_task sleeper(mylib::timer_wheel& wheel, mylib::inplace_stop_token token, bool& resumed) {
+    co_await mylib::with_stop_token(token, sleep_long(wheel));
+    resumed = true;
+}
+
+// A stop request cancels the pending sleep and completes the sleeper stopped
+void stop_cancels_sleep() {
+    mylib::timer_wheel wheel;
+    mylib::inplace_stop_source source;
+    bool resumed = false;
+    sleeper(wheel, source.get_token(), resumed).start();
+    CHECK(source.request_stop());
+    CHECK(!resumed);
+}
+
+mylib::task<int> quick() { co_return 7; }
+
+mylib::task<int> race(mylib::timer_wheel& wheel) {
+    auto result = co_await mylib::when_any(sleep_long(wheel), quick());
+    co_return result.index() == 1 ? std::get<1>(result) : -1;
+}
+
+// The winner stops the losers through the token of when_any
+void when_any_stops_losers() {
+    mylib::timer_wheel wheel;
+    CHECK(mylib::sync_wait(race(wheel)) == 7);
+}
+
+int main() {
+    callbacks_run_once();
+    callback_destroys_itself();
+    deregistration_waits_for_callback();
+    token_propagates_down_the_chain();
+    stop_cancels_sleep();
+    when_any_stops_losers();
+    std::println("stop_token: ok");
+}
@@ -0,0 +1,78 @@
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+
+#include "check.hpp"
+#include "detached_task.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+std::atomic<int> errors = 0;
+
+void count_error(std::exception_ptr e) noexcept {
+    try {
+        std::rethrow_exception(e);
+    } catch (const std::runtime_error&) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    } catch (...) {
+        std::terminate();
+    }
+}
+
+mylib::task<bool> runs_on(mylib::thread_pool& pool) {
+    co_await pool.schedule();
+    co_return pool.on_pool_thread() && mylib::thread_pool::current() == &pool;
+}
+
+void schedule_moves_to_worker() {
+    mylib::thread_pool pool(2);
+    CHECK(!pool.on_pool_thread());
+    CHECK(mylib::thread_pool::current() == nullptr);
+    CHECK(mylib::sync_wait(runs_on(pool)));
+}
+
+// Spawned from a worker, children go to its own deque, where the other workers steal them
+mylib::detached_task fan_out(mylib::thread_pool& pool, int depth, std::atomic<int>& ran) {
+    ran.fetch_add(1, std::memory_order_relaxed);
+    if (depth > 0) {
+        pool.spawn(fan_out(pool, depth - 1, ran));
+        pool.spawn(fan_out(pool, depth - 1, ran));
+    }
+    co_return;
+}
+
+void queued_work_runs_before_join() {
+    std::atomic<int> ran = 0;
+    {
+        mylib::thread_pool pool(4);
+        for (int i = 0; i < 16; ++i) {
+            pool.spawn(fan_out(pool, 10, ran));
+        }
+    }
+    CHECK(ran.load() == 16 * 2047);
+}
+
+mylib::detached_task fail_on_worker(mylib::thread_pool& pool) {
+    co_await pool.schedule();
+    throw std::runtime_error("detached");
+}
+
+void failures_reach_on_error() {
+    errors.store(0);
+    {
+        mylib::thread_pool pool(3, &count_error);
+        for (int i = 0; i < 100; ++i) {
+            fail_on_worker(pool).start();
+        }
+        CHECK(mylib::sync_wait(runs_on(pool)));
+    }
+    CHECK(errors.load() == 100);
+}
+
+int main() {
+    schedule_moves_to_worker();
+    queued_work_runs_before_join();
+    failures_reach_on_error();
+    std::println("thread_pool: ok");
+}
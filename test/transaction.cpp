@@ -0,0 +1,236 @@
+#include <coroutine>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cancellation.hpp"
+#include "check.hpp"
+#include "detached_task.hpp"
+#include "stop_token.hpp"
+#include "sync_wait.hpp"
+#include "task.hpp"
+#include "transaction.hpp"
+
+// Completes the awaiting coroutine stopped
+struct just_stopped
+{
+    constexpr bool await_ready() const noexcept { return false; }
+
+    template<typename PromiseType>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> h) noexcept {
+        return h.promise().unhandled_stopped();
+    }
+
+    [[noreturn]]
+    void await_resume() const noexcept { std::unreachable(); }
+};
+
+struct counting_database
+{
+    mylib::task<int> transaction_begin() { ++this->begins; co_return 1; }
+    mylib::task<void> transaction_commit() { ++this->commits; co_return; }
+    mylib::task<void> transaction_rollback() { ++this->rollbacks; co_return; }
+
+    int begins = 0;
+    int commits = 0;
+    int rollbacks = 0;
+};
+
+// Sets its flag once destroyed
+struct destroyed_flag
+{
+    explicit destroyed_flag(bool& flag) noexcept : flag(&flag) {}
+    ~destroyed_flag() { *this->flag = true; }
+    bool* flag;
+};
+
+template<typename ReturnType>
+mylib::transaction<ReturnType> stopped_body(counting_database& db, bool& body_destroyed) {
+    destroyed_flag _(body_destroyed);
+    co_await just_stopped{};
+    co_return ReturnType();
+}
+
+template<typename ReturnType>
+mylib::detached_task stopped_caller(counting_database& db, bool& body_destroyed, bool& caller_destroyed, bool& resumed) {
+    destroyed_flag _(caller_destroyed);
+    static_cast<void>(co_await stopped_body<ReturnType>(db, body_destroyed));
+    resumed = true;
+}
+
+// The stop is relayed to the caller after the rollback, from the frame reserved in the transaction,
+// and the detached caller is then reaped from the reserved frame of its thread
+template<typename ReturnType>
+void stop_reaches_caller() {
+    counting_database db;
+    bool body_destroyed = false;
+    bool caller_destroyed = false;
+    bool resumed = false;
+    stopped_caller<ReturnType>(db, body_destroyed, caller_destroyed, resumed).start();
+    CHECK(db.begins == 1);
+    CHECK(db.rollbacks == 1);
+    CHECK(db.commits == 0);
+    CHECK(body_destroyed);
+    CHECK(caller_destroyed);
+    CHECK(!resumed);
+}
+
+void stop_reaches_sync_wait() {
+    counting_database db;
+    bool body_destroyed = false;
+    bool stopped = false;
+    try {
+        mylib::sync_wait(stopped_body<int>(db, body_destroyed));
+    } catch (const mylib::sync_wait_stopped_exception&) {
+        stopped = true;
+    }
+    CHECK(stopped);
+    CHECK(db.rollbacks == 1);
+    CHECK(body_destroyed);
+}
+
+// Holds the coroutines awaiting it until opened
+struct gate
+{
+    struct awaiter
+    {
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { this->owner->waiting.push_back(h); }
+        constexpr void await_resume() const noexcept {}
+        gate* owner;
+    };
+
+    awaiter wait() noexcept { return { this }; }
+
+    void open() {
+        for (std::coroutine_handle<> h : std::exchange(this->waiting, {})) {
+            h.resume();
+        }
+    }
+
+    std::vector<std::coroutine_handle<>> waiting;
+};
+
+// Resource of a multi-resource transaction, two-phase committed.
+// Its rollback observes the stop token it is called with, as a real one waiting on I/O would.
+struct preparing_database
+{
+    mylib::task<int> transaction_begin() {
+        ++this->begins;
+        if (this->begin_gate) {
+            co_await this->begin_gate->wait();
+        }
+        ++this->begun;
+        co_return 1;
+    }
+
+    mylib::task<void> transaction_prepare() {
+        if (this->fail_prepare) {
+            throw std::runtime_error("prepare");
+        }
+        this->prepared = this->clock++;
+        co_return;
+    }
+
+    mylib::task<void> transaction_commit() {
+        this->committed = this->clock++;
+        co_return;
+    }
+
+    mylib::task<void> transaction_rollback() {
+        co_await mylib::stop_checkpoint();
+        ++this->rollbacks;
+    }
+
+    gate* begin_gate = nullptr;
+    bool fail_prepare = false;
+    int begins = 0;
+    int begun = 0;
+    int rollbacks = 0;
+    int prepared = -1;
+    int committed = -1;
+    // Shared by both resources to order their calls
+    static inline int clock = 0;
+};
+
+mylib::transaction<int> both(preparing_database& a, preparing_database& b) {
+    co_return a.begun + b.begun;
+}
+
+mylib::detached_task run_both(preparing_database& a, preparing_database& b, int& result) {
+    result = co_await both(a, b);
+}
+
+void multi_begins_concurrently_then_commits() {
+    gate begins;
+    preparing_database a;
+    preparing_database b;
+    a.begin_gate = &begins;
+    b.begin_gate = &begins;
+    int result = 0;
+    run_both(a, b, result).start();
+    // Both begins started before either completed
+    CHECK(a.begins == 1 && b.begins == 1);
+    CHECK(a.begun == 0 && b.begun == 0);
+    CHECK(begins.waiting.size() == 2);
+    begins.open();
+    CHECK(result == 2);
+    CHECK(a.prepared >= 0 && b.prepared >= 0);
+    CHECK(a.committed > b.prepared && b.committed > a.prepared);
+    CHECK(a.rollbacks == 0 && b.rollbacks == 0);
+}
+
+void multi_failed_prepare_rolls_back_all() {
+    preparing_database a;
+    preparing_database b;
+    b.fail_prepare = true;
+    bool caught = false;
+    try {
+        mylib::sync_wait(both(a, b));
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    CHECK(caught);
+    CHECK(a.committed < 0 && b.committed < 0);
+    CHECK(a.rollbacks == 1);
+    CHECK(b.rollbacks == 1);
+}
+
+mylib::transaction<int> stop_in_body(preparing_database& a, preparing_database& b, mylib::inplace_stop_source& source) {
+    source.request_stop();
+    co_await mylib::stop_checkpoint();
+    co_return 0;
+}
+
+mylib::task<int> under_stop(preparing_database& a, preparing_database& b, mylib::inplace_stop_source& source) {
+    co_return co_await stop_in_body(a, b, source);
+}
+
+// The rollback after a stop runs under no token, so it is not stopped in turn
+void multi_stop_in_body_rolls_back() {
+    preparing_database a;
+    preparing_database b;
+    mylib::inplace_stop_source source;
+    bool stopped = false;
+    try {
+        mylib::sync_wait(mylib::with_stop_token(source.get_token(), under_stop(a, b, source)));
+    } catch (const mylib::sync_wait_stopped_exception&) {
+        stopped = true;
+    }
+    CHECK(stopped);
+    CHECK(a.committed < 0 && b.committed < 0);
+    CHECK(a.rollbacks == 1);
+    CHECK(b.rollbacks == 1);
+}
+
+int main() {
+    stop_reaches_caller<int>();
+    stop_reaches_caller<void>();
+    stop_reaches_caller<std::string>();
+    stop_reaches_sync_wait();
+    multi_begins_concurrently_then_commits();
+    multi_failed_prepare_rolls_back_all();
+    multi_stop_in_body_rolls_back();
+    std::println("transaction: ok");
+}
@@ -1,20 +1,46 @@
 add_rules("mode.debug", "mode.release")
 set_languages("c++26")
 set_encodings("utf-8")
-add_files("src/*.cpp")
 add_includedirs("include")
 add_rules("plugin.compile_commands.autoupdate", {outputdir = ".vscode"})
 
 target("gnu")
     set_kind("binary")
+    add_files("src/*.cpp")
     set_toolchains("gcc")
     add_linkdirs("/usr/local/lib/../lib64")
     add_rpathdirs("/usr/local/lib/../lib64")
 
 target("llvm")
     set_kind("binary")
+    add_files("src/*.cpp")
     set_toolchains("clang")
     add_cxxflags("-stdlib=libc++")
     add_ldflags("-lc++")
     add_linkdirs("/usr/local/lib/x86_64-unknown-linux-gnu")
     add_rpathdirs("/usr/local/lib/x86_64-unknown-linux-gnu")
+
+-- One program per file under test/, run by `xmake test`
+for _, file in ipairs(os.files("test/*.cpp")) do
+    target("test_" .. path.basename(file))
+        set_kind("binary")
+        set_default(false)
+        add_files(file)
+        set_toolchains("gcc")
+        add_linkdirs("/usr/local/lib/../lib64")
+        add_rpathdirs("/usr/local/lib/../lib64")
+        add_syslinks("pthread")
+        add_tests("default")
+end
+
+-- Benchmarks, one program per file under bench/, meant for release builds
+for _, file in ipairs(os.files("bench/*.cpp")) do
+    target("bench_" .. path.basename(file))
+        set_kind("binary")
+        set_default(false)
+        add_files(file)
+        set_toolchains("gcc")
+        add_linkdirs("/usr/local/lib/../lib64")
+        add_rpathdirs("/usr/local/lib/../lib64")
+        add_syslinks("pthread")
+end